@@ -14,25 +14,41 @@ DEFINES += QT_DEPRECATED_WARNINGS
 INCLUDEPATH += include
 
 HEADERS += include/action.h \
+           include/bench.h \
            include/board.h \
            include/eval.h \
            include/hash.h \
            include/init.h \
+           include/magic.h \
            include/move.h \
            include/parse.h \
+           include/picker.h \
            include/play.h \
            include/search.h \
+           include/selftest.h \
+           include/table.h \
+           include/timeman.h \
            include/twiddle.h \
-           include/typedefs.h
+           include/typedefs.h \
+           include/uci.h
 SOURCES += src/action.cpp \
+           src/bench.cpp \
            src/board.cpp \
            src/check.cpp \
            src/eval.cpp \
            src/hash.cpp \
            src/init.cpp \
+           src/magic.cpp \
            src/main.cpp \
            src/move.cpp \
+           src/picker.cpp \
            src/play.cpp \
-           src/search.cpp
+           src/search.cpp \
+           src/selftest.cpp \
+           src/table.cpp \
+           src/timeman.cpp \
+           src/uci.cpp
+
+CONFIG += c++14 thread
 
 QT -= core gui
@@ -28,6 +28,9 @@ Board doMove(Board startBoard, move_t move);
  *  \param startBoard       A pointer to the board before the move is made.
  *  \param move             The move to be made.
  *  \return                 A pointer to the board after the move is made.
+ *                          The board is allocated with new, and the caller
+ *                          is responsible for deleting it. The search uses
+ *                          \ref Board::makeMove instead.
  */
 Board* doMove(Board* startBoard, move_t move);
 
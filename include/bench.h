@@ -0,0 +1,67 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_CORE_BENCH_H_
+#define SRC_CORE_BENCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+
+namespace chessCore {
+
+/** The seed for the hash keys in a benchmark, see \ref init(uint64_t). */
+constexpr uint64_t BENCH_SEED = 1234;
+
+/** The depth each benchmark position is searched to by default. */
+constexpr int BENCH_DEPTH = 10;
+
+/**
+ *  Run the benchmark: search each of a fixed set of positions to a fixed
+ *  depth, on one thread and as a new game (see \ref Searcher::new_game),
+ *  and report the nodes searched and the speed.
+ *
+ *  The total node count is a signature of the search: with the hash keys
+ *  from \ref init(uint64_t) seeded with BENCH_SEED it's the same on every
+ *  run, and changes whenever the search's behaviour does. The nodes per
+ *  second measure its speed.
+ *
+ *  \param depth        The depth to search each position to. Values less
+ *                      than 1 are treated as 1.
+ *  \param out          The stream to write the report to.
+ *  \return             The total number of nodes searched.
+ */
+uint64_t bench(int depth = BENCH_DEPTH, std::ostream& out = std::cout);
+
+/**
+ *  Time the slider attack lookups of the ray walker and of each table
+ *  backend the CPU supports, on the same random occupancies, and report
+ *  the time per lookup. Leaves the selected backend as it was.
+ *
+ *  \param out          The stream to write the report to.
+ */
+void bench_sliders(std::ostream& out = std::cout);
+
+/** The table size \ref bench_table uses by default, in megabytes. */
+constexpr size_t TABLE_BENCH_MB = 1;
+
+/**
+ *  Compare the packed transposition table records with the 16-byte
+ *  records they replaced, at the same memory. Each table prunes a tree
+ *  walk over a few positions: a node isn't expanded again if the table
+ *  already has it at least as deep. Reports the records per megabyte, the
+ *  hit rate and the nodes walked for both.
+ *
+ *  \param mb           The size of both tables, in megabytes.
+ *  \param out          The stream to write the report to.
+ */
+void bench_table(size_t mb = TABLE_BENCH_MB, std::ostream& out = std::cout);
+
+}   // namespace chessCore
+
+#endif  // SRC_CORE_BENCH_H_
@@ -72,6 +72,40 @@ extern const char colours[2];
 void print_bb(bitboard bb, char c = 'x', std::ostream& cout = std::cout);
 
 
+/**
+ *  \struct undo_t
+ *
+ *  \brief The state needed to take back a move made in-place.
+ *
+ *  Filled by \ref Board::makeMove and consumed by \ref Board::unmakeMove.
+ *  Holds everything that can't be recovered from the move itself: the
+ *  captured piece, the castling rights, the en-passant information, the
+ *  clocks, the running evaluation and the hash.
+ */
+struct undo_t {
+    /** The colour/piece combination captured by the move, or -1 if none. */
+    int captured;
+    /** The castling rights before the move. */
+    bool castling[4];
+    /** Whether the move before this one was a double pawn push. */
+    bool ep;
+    /** The file of the double-pushed pawn, if relevant. */
+    int dpp;
+    /**@{*/
+    /** The half- and full- move clocks before the move. */
+    uint8_t halfMoveClock;
+    uint8_t fullMoveClock;
+    /**@}*/
+    /**@{*/
+    /** The opening and endgame values before the move. */
+    value_t opening_value;
+    value_t endgame_value;
+    /**@}*/
+    /** The Zobrist hash before the move. */
+    uint64_t hash_value;
+};
+
+
 /**
  *  \class Board
  *  \brief Represents the state of the chessboard.
@@ -207,16 +241,6 @@ class Board {
      */
     value_t evaluateEndgame() const;
 
-    /**
-     *  Calculate the phase of the game based on the number of pieces
-     *  left on the board.
-     *
-     *  \return         An integer between 0 and 256 representing the phase
-                        of the game. 0 corresponds to the opening and 256
-                        corresponds to the endgame.
-     */
-    int getPhase() const;
-
     /**
      *  Get a bitboard representing the locations of the white pieces.
      *
@@ -253,6 +277,17 @@ class Board {
      */
     void add_moves(MoveList* dest, move_t move, bool legal_check) const;
 
+    /**
+     *  Generate pseudo-legal moves of the chosen kinds.
+     *  Used by \ref Board::gen_moves, \ref Board::gen_tactical_moves and
+     *  \ref Board::gen_quiet_moves.
+     *
+     *  \param dest             A pointer to the MoveList object.
+     *  \param tactical         Whether to generate captures and promotions.
+     *  \param quiet            Whether to generate all other moves.
+     */
+    void gen_pseudo_moves(MoveList* dest, bool tactical, bool quiet) const;
+
     /**
      *  Generate all moves that get the side to move out of check.
      *
@@ -381,6 +416,34 @@ class Board {
      */
     void getBitboards(bitboard* dest) const;
 
+    /**
+     *  Find the piece on a given square.
+     *
+     *  \param square       The index of the square.
+     *  \return             The colour/piece combination on the square, or
+     *                      -1 if the square is empty. See \ref colourPiece.
+     */
+    int piece_at(int square) const;
+
+    /**
+     *  Check whether a side has any pieces other than pawns and its king.
+     *
+     *  \param side             The side to check.
+     *  \return                 True if side has a knight, bishop, rook or
+     *                          queen, false otherwise.
+     */
+    bool has_non_pawn_material(colour side) const;
+
+    /**
+     *  Calculate the phase of the game based on the number of pieces
+     *  left on the board.
+     *
+     *  \return         An integer between 0 and 256 representing the phase
+                        of the game. 0 corresponds to the opening and 256
+                        corresponds to the endgame.
+     */
+    int getPhase() const;
+
     /**
      *  Get a copy of the castling rights.
      *
@@ -573,6 +636,53 @@ class Board {
      */
     bool is_legal(move_t move) const;
 
+    /**
+     *  Check if a move could have been generated by \ref gen_moves in the
+     *  current board state. Used to check moves that weren't generated
+     *  here, such as moves from the transposition table.
+     *
+     *  \param move             A move to check.
+     *  \return                 True if the move is pseudo-legal, false
+     *                          otherwise.
+     */
+    bool is_pseudo_legal(move_t move) const;
+
+    /**
+     *  Find all the pieces, of either colour, that attack a square.
+     *
+     *  \param square           The index of the square.
+     *  \param occupied         The occupied squares. Sliders are blocked by
+     *                          these, and only pieces on them are returned.
+     *  \return                 A bitboard of the attacking pieces.
+     */
+    bitboard attackers_to(int square, bitboard occupied) const;
+
+    /**
+     *  Static exchange evaluation: the material the side to move gains from
+     *  a move, if both sides keep recapturing on the destination square
+     *  with their least valuable piece for as long as it pays. Pieces
+     *  behind a capturing slider join in once it has moved.
+     *
+     *  \param move             The move to evaluate. Must be pseudo-legal.
+     *  \return                 The material gained, negative if the move
+     *                          loses material.
+     */
+    value_t see(move_t move) const;
+
+    /**
+     *  Generate all pseudo-legal captures and promotions.
+     *
+     *  \return                 A \ref MoveList of generated moves.
+     */
+    MoveList gen_tactical_moves() const;
+
+    /**
+     *  Generate all pseudo-legal moves that aren't captures or promotions.
+     *
+     *  \return                 A \ref MoveList of generated moves.
+     */
+    MoveList gen_quiet_moves() const;
+
     /**
      *  Generate all captures from a given position.
      *
@@ -596,6 +706,39 @@ class Board {
      */
     void doMoveInPlace(move_t move);
 
+    /**
+     *  Do a move in-place, saving the information needed to take it back.
+     *  Used by the search, so that a whole search runs on a single board.
+     *
+     *  \param move             The move to make. Must be legal.
+     *  \param[out] undo        The record to save the board state in.
+     */
+    void makeMove(move_t move, undo_t* undo);
+
+    /**
+     *  Take back a move made by \ref makeMove.
+     *
+     *  \param move             The move to take back. Must be the last
+     *                          move made.
+     *  \param undo             The record filled in by \ref makeMove.
+     */
+    void unmakeMove(move_t move, const undo_t& undo);
+
+    /**
+     *  Pass the move to the other side, for null-move pruning. Any en
+     *  passant capture is lost, and the hash is updated to match.
+     *
+     *  \param[out] undo        The record to save the board state in.
+     */
+    void makeNullMove(undo_t* undo);
+
+    /**
+     *  Take back a null move made by \ref makeNullMove.
+     *
+     *  \param undo             The record filled in by \ref makeNullMove.
+     */
+    void unmakeNullMove(const undo_t& undo);
+
     /**
      *  Calculate the Zobrist hash of the board state.
      *  See \ref hash.h.
@@ -613,6 +756,16 @@ class Board {
      */
     bool is_check(colour side) const;
 
+    /**
+     *  Test if a move would put the other side in check, without making it:
+     *  either the moved piece attacks the king from its destination, or
+     *  moving it opens a line to the king for a rook, bishop or queen.
+     *
+     *  \param move             A legal move for the side to move.
+     *  \return                 True if the move gives check, false otherwise.
+     */
+    bool gives_check(move_t move) const;
+
     /**
      *  Test if a given side is in check. If so, output the type and location
      *  of the checking piece, and whether the king is in double check.
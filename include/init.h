@@ -15,20 +15,24 @@ namespace chessCore {
 /**
  *  Initialise some global constants.
  *
- *  Initialise a the 2-D array of bitboards rays, and the hash keys.
- *  The rays are generated by init_rays(), and the hash keys by init_keys().
- *  See \ref move.h and \ref hash.h.
+ *  Initialise a the 2-D array of bitboards rays, the magic attack tables,
+ *  the hash keys and the late move reductions. The rays are generated by
+ *  init_rays(), the attack tables by init_magics(), the hash keys by
+ *  init_keys() and the reductions by init_reductions().
+ *  See \ref move.h, \ref magic.h, \ref hash.h and \ref search.h.
  */
 void init();
 
 /**
  *  Initialise some global constants.
  *
- *  Initialise a the 2-D array of bitboards rays, and the hash keys.
- *  The rays are generated by init_rays, and the hash keys by init_keys().
+ *  Initialise a the 2-D array of bitboards rays, the magic attack tables,
+ *  the hash keys and the late move reductions. The rays are generated by
+ *  init_rays, the attack tables by init_magics(), the hash keys by
+ *  init_keys() and the reductions by init_reductions().
  *  The only difference to \ref init() is that the seed for the hash keys
  *  can be specified, for debugging.
- *  See \ref move.h and \ref hash.h.
+ *  See \ref move.h, \ref magic.h, \ref hash.h and \ref search.h.
  *
  *  \param seed     The seed to be used for the hash keys.
  */
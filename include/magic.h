@@ -0,0 +1,159 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_CORE_MAGIC_H_
+#define SRC_CORE_MAGIC_H_
+
+#include "typedefs.h"
+
+// the PEXT backend needs the BMI2 intrinsics and a way of compiling a single
+// function for BMI2, the rest of the binary stays portable
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CHESSCORE_PEXT 1
+#else
+#define CHESSCORE_PEXT 0
+#endif
+
+namespace chessCore {
+
+/**
+ *  \enum sliderBackend
+ *  An Enum to specify how the slider attack tables are indexed.
+ */
+enum sliderBackend {
+    magicBackend,
+    pextBackend
+};
+
+/**
+ *  \struct magic_t
+ *
+ *  \brief The lookup parameters for the sliding attacks from a single square.
+ *
+ *  The attacks of a rook or bishop only depend on the occupancy of the
+ *  squares in its "relevant" mask (the rays from the square, excluding the
+ *  edge of the board). Multiplying the masked occupancy by a magic number
+ *  and keeping the top bits gives a perfect hash of every possible
+ *  occupancy into a table of pre-computed attack bitboards. On CPUs with
+ *  fast BMI2, PEXT gathers the masked bits directly into a dense index
+ *  instead, and the same table slices are filled in that order.
+ */
+struct magic_t {
+    /** The relevant occupancy mask for the square. */
+    bitboard mask;
+    /** The magic multiplier for the square. */
+    bitboard magic;
+    /** A pointer to the square's slice of the shared attack table. */
+    bitboard* attacks;
+    /** The number of bits to shift the product by, i.e. 64 - bits(mask). */
+    int shift;
+};
+
+/**@{*/
+/** The magic lookup parameters for rooks and bishops, indexed by square. */
+extern magic_t rookMagics[64];
+extern magic_t bishopMagics[64];
+/**@}*/
+
+/**
+ *  The backend currently used to index the attack tables.
+ *  Set by \ref init_magics, don't modify it directly.
+ */
+extern sliderBackend slider_backend;
+
+/**
+ *  Check whether the CPU supports BMI2 and executes PEXT in hardware.
+ *  AMD processors before Zen 3 support BMI2, but implement PEXT in
+ *  microcode, which is slower than a magic multiplication.
+ *
+ *  \return                 True if the PEXT backend should be used.
+ */
+bool cpu_has_fast_pext();
+
+/**
+ *  Generate the relevant occupancy masks and fill the shared attack tables,
+ *  using magic multiplication. The PEXT lookups are compiled for BMI2 on
+ *  their own, so they can't be inlined into move generation, and the calls
+ *  cost more than PEXT saves: perft and search are 5-15% slower with them.
+ *  The tables are filled using \ref rookPushNaive and \ref bishopPushNaive,
+ *  so the rays must already have been generated by \ref init_rays.
+ */
+void init_magics();
+
+/**
+ *  Generate the relevant occupancy masks and fill the shared attack tables
+ *  for a particular backend, e.g. to compare them. If the PEXT backend is
+ *  requested but not supported, fall back to magic multiplication.
+ *
+ *  \param backend          The backend to use.
+ */
+void init_magics(sliderBackend backend);
+
+#if CHESSCORE_PEXT
+/**@{*/
+/**
+ *  Look up the rook or bishop attacks from a given square, indexing the
+ *  table with the BMI2 PEXT instruction. These are compiled separately
+ *  for BMI2, so only call them if the PEXT backend has been selected.
+ *
+ *  \param sq               The square to move from.
+ *  \param blockers         A bitboard representing all pieces on the board.
+ *  \return                 The bitboard representing the possible moves,
+ *                          including captures of either colour.
+ */
+bitboard rookAttacksPext(int sq, bitboard blockers);
+bitboard bishopAttacksPext(int sq, bitboard blockers);
+/**@}*/
+#endif
+
+/**
+ *  Look up the rook attacks from a given square.
+ *
+ *  \param sq               The square to move from.
+ *  \param blockers         A bitboard representing all pieces on the board.
+ *  \return                 The bitboard representing the possible moves,
+ *                          including captures of either colour.
+ */
+inline bitboard rookAttacks(int sq, bitboard blockers) {
+#if CHESSCORE_PEXT
+    if (slider_backend == pextBackend) return rookAttacksPext(sq, blockers);
+#endif
+    const magic_t& m = rookMagics[sq];
+    return m.attacks[((blockers & m.mask) * m.magic) >> m.shift];
+}
+
+/**
+ *  Look up the bishop attacks from a given square.
+ *
+ *  \param sq               The square to move from.
+ *  \param blockers         A bitboard representing all pieces on the board.
+ *  \return                 The bitboard representing the possible moves,
+ *                          including captures of either colour.
+ */
+inline bitboard bishopAttacks(int sq, bitboard blockers) {
+#if CHESSCORE_PEXT
+    if (slider_backend == pextBackend) return bishopAttacksPext(sq, blockers);
+#endif
+    const magic_t& m = bishopMagics[sq];
+    return m.attacks[((blockers & m.mask) * m.magic) >> m.shift];
+}
+
+/**
+ *  Look up the queen attacks from a given square.
+ *
+ *  \param sq               The square to move from.
+ *  \param blockers         A bitboard representing all pieces on the board.
+ *  \return                 The bitboard representing the possible moves,
+ *                          including captures of either colour.
+ */
+inline bitboard queenAttacks(int sq, bitboard blockers) {
+    return rookAttacks(sq, blockers) | bishopAttacks(sq, blockers);
+}
+
+}   // namespace chessCore
+
+#endif  // SRC_CORE_MAGIC_H_
@@ -203,7 +203,7 @@ std::string mtos(move_t move);
  *  \param s                The string to convert.
  *  \return                 A move_t object corresponding to the move string.
  */
-move_t stom(MoveList moves, std::string s);
+move_t stom(const MoveList& moves, std::string s);
 
 
 /**
@@ -288,7 +288,8 @@ bitboard kingTargets(int sq, bitboard _white, bitboard _black,
                      colour movingColour);
 
 /**
- *  Calculate the naive bishop moves from a given square.
+ *  Calculate the naive bishop moves from a given square by walking
+ *  the rays. Slow, but used as the reference for the magic tables.
  *
  *  \param sq               The square to move from.
  *  \param blockers         A bitboard representing all pieces on the board.
@@ -308,7 +309,8 @@ bitboard bishopTargets(int sq, bitboard _white, bitboard _black,
                        colour movingColour);
 
 /**
- *  Calculate the naive rook moves from a given square.
+ *  Calculate the naive rook moves from a given square by walking
+ *  the rays. Slow, but used as the reference for the magic tables.
  *
  *  \param sq               The square to move from.
  *  \param blockers         A bitboard representing all pieces on the board.
@@ -328,7 +330,8 @@ bitboard rookTargets(int sq, bitboard _white, bitboard _black,
                      colour movingColour);
 
 /**
- *  Calculate the naive queen moves from a given square.
+ *  Calculate the naive queen moves from a given square by walking
+ *  the rays. Slow, but used as the reference for the magic tables.
  *
  *  \param sq               The square to move from.
  *  \param blockers         A bitboard representing all pieces on the board.
@@ -0,0 +1,207 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_CORE_PICKER_H_
+#define SRC_CORE_PICKER_H_
+
+#include "board.h"
+#include "typedefs.h"
+
+
+namespace chessCore {
+
+/** The deepest ply the search keeps killer moves for. */
+constexpr int MAX_PLY = 128;
+
+/** The number of killer moves kept per ply. */
+constexpr int NUM_KILLERS = 2;
+
+/** The largest magnitude of a history score. */
+constexpr int MAX_HISTORY = 16384;
+
+/**
+ *  \struct heuristics_t
+ *
+ *  \brief What the search has learned about quiet moves that cause
+ *  beta cutoffs, used to order the quiet moves of other nodes.
+ */
+struct heuristics_t {
+    /** The latest quiet moves to cause a cutoff at each ply. */
+    move_t killers[MAX_PLY][NUM_KILLERS];
+
+    /**
+     *  The history scores of quiet moves, indexed by side to move, from
+     *  square and to square. Moves that cause cutoffs gain score, and the
+     *  moves tried before them lose it.
+     */
+    int history[2][64][64];
+
+    /**
+     *  The latest quiet move to cause a cutoff in reply to a move, indexed
+     *  by the from square and to square of that move.
+     */
+    move_t counter_moves[64][64];
+
+    /** Forget everything. */
+    void clear();
+
+    /**
+     *  Start a new search: forget the killer moves, which belong to
+     *  particular plies of the previous search, and halve the history
+     *  scores so that recent cutoffs count for more.
+     */
+    void new_search();
+
+    /**
+     *  Record a beta cutoff caused by a quiet move.
+     *
+     *  \param side         The side to move.
+     *  \param ply          The distance of the node from the root.
+     *  \param depth        The depth the node was searched to.
+     *  \param move         The move that caused the cutoff.
+     *  \param prev_move    The move that led to the node, or 0 at the root.
+     *  \param tried        The quiet moves searched before move.
+     *  \param num_tried    The number of moves in tried.
+     */
+    void update(colour side, int ply, int depth, move_t move,
+                move_t prev_move, const move_t* tried, int num_tried);
+};
+
+/**
+ *  \enum pickStage
+ *
+ *  An Enum to specify the stages of a \ref MovePicker, in the order they
+ *  are visited.
+ */
+enum pickStage {
+    firstMoveStage,
+    ttMoveStage,
+    genTacticalStage,
+    tacticalStage,
+    killerStage,
+    genQuietStage,
+    quietStage,
+    genEvasionStage,
+    evasionStage,
+    doneStage
+};
+
+/**
+ *  \class MovePicker
+ *  \brief Hands out the moves of a position one at a time, best first,
+ *  generating them in stages.
+ *
+ *  The hash moves are tried first, without generating any moves at all.
+ *  Then captures and promotions are generated and tried by MVV-LVA, as
+ *  long as they don't lose material by static exchange evaluation. Next
+ *  come the killer moves and the counter-move, then the rest of the quiet
+ *  moves by history score, and last the losing captures. Moves are generated
+ *  pseudo-legal, and legality is only checked once a move is about to be
+ *  searched. A node that cuts off early doesn't pay to generate, or
+ *  check, the rest.
+ *
+ *  When the side to move is in check, the legal evasions are generated
+ *  in one go instead.
+ */
+class MovePicker {
+ private:
+    /** The board to pick moves on. */
+    const Board* board;
+
+    /** The current stage. */
+    pickStage stage;
+
+    /** The move to try first, or 0 if there isn't one. */
+    move_t first_move;
+
+    /** The move from the transposition table, or 0 if there isn't one. */
+    move_t tt_move;
+
+    /** Whether to skip the quiet moves, see \ref MovePicker(const Board*). */
+    bool tactical_only;
+
+    /** The history scores for the side to move, or nullptr if unused. */
+    const int (*history)[64];
+
+    /** The killer moves and counter-move, tried before the other quiets. */
+    move_t refutations[NUM_KILLERS + 1];
+
+    /** The number of refutations. */
+    int num_refutations;
+
+    /** The moves generated in the current stage. */
+    MoveList moves;
+
+    /** The ordering scores of moves. */
+    int scores[MAX_MOVES];
+
+    /** The index of the next move in moves. */
+    int index;
+
+    /** The captures that lose material, tried after the quiet moves. */
+    MoveList bad_captures;
+
+    /**
+     *  Check a hash move, which might come from another position.
+     *
+     *  \param move         The move to check.
+     *  \return             True if the move is legal here, false otherwise.
+     */
+    bool is_valid_hash_move(move_t move) const;
+
+    /** Score every move in moves, once. */
+    void score_moves();
+
+    /**
+     *  Take the highest-scoring move left in the current stage, skipping
+     *  the hash moves and the refutations.
+     *
+     *  \param legal_check  Whether to skip illegal moves.
+     *  \param good_captures Whether to stop at the first capture that loses
+     *                      material, by \ref Board::see.
+     *  \return             The move, or 0 if the stage has no moves left.
+     */
+    move_t select(bool legal_check, bool good_captures);
+
+ public:
+    /**
+     *  Construct a picker for all the moves of a position.
+     *
+     *  \param b            The board to pick moves on. Must be back in the
+     *                      same state whenever \ref next is called.
+     *  \param first_move   A move to try first, or 0.
+     *  \param tt_move      A move from the transposition table to try next,
+     *                      or 0.
+     *  \param heur         The killer, history and counter-move tables, or
+     *                      nullptr to order quiet moves without them.
+     *  \param ply          The distance of the node from the root.
+     *  \param prev_move    The move that led to the node, or 0 at the root.
+     */
+    MovePicker(const Board* b, move_t first_move, move_t tt_move,
+               const heuristics_t* heur = nullptr, int ply = 0,
+               move_t prev_move = 0);
+
+    /**
+     *  Construct a picker for just the captures and promotions of a
+     *  position that don't lose material, for the quiescence search.
+     *
+     *  \param b            The board to pick moves on. Must be back in the
+     *                      same state whenever \ref next is called.
+     */
+    explicit MovePicker(const Board* b);
+
+    /**
+     *  Get the next legal move.
+     *
+     *  \return             The next move to search, or 0 if there are none.
+     */
+    move_t next();
+};
+
+}   // namespace chessCore
+
+#endif  // SRC_CORE_PICKER_H_
@@ -64,6 +64,32 @@ class Player : public Board {
      */
     int iterative_deepening_timeout;
 
+    /**
+     *  Whether to ponder: search the user's expected reply while they think.
+     */
+    bool ponder;
+
+    /** The reply being pondered on, or 0 if the engine isn't pondering. */
+    move_t ponder_move;
+
+    /**
+     *  Guess the user's reply from the transposition table, and start
+     *  searching the position after it in the background.
+     *
+     *  \param timeout      The cutoff time for the search after a ponder hit.
+     */
+    void start_pondering(int timeout);
+
+    /**
+     *  End pondering once the user has moved. On a ponder hit the search
+     *  carries on under its real time limit, so take its move with
+     *  Searcher::wait; on a miss it's stopped and its result thrown away.
+     *
+     *  \param move         The move the user played.
+     *  \return             True on a ponder hit.
+     */
+    bool end_pondering(move_t move);
+
  public:
     // constructors
     // defined in play.cpp
@@ -178,9 +204,9 @@ class Player : public Board {
     /**
      *  Access the transposition table.
      *
-     *  \return                 A copy of the transposition table.
+     *  \return                 A reference to the transposition table.
      */
-    TransTable getTable() const;
+    const TransTable& getTable() const;
 
     /**@{*/
     /**
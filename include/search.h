@@ -8,61 +8,225 @@ LICENSE file in the root directory of this source tree.
 #ifndef SRC_CORE_SEARCH_H_
 #define SRC_CORE_SEARCH_H_
 
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <limits>
+#include <thread>
+#include <vector>
 
 #include "board.h"
 #include "move.h"
+#include "picker.h"
+#include "table.h"
+#include "timeman.h"
 #include "typedefs.h"
 
 
 namespace chessCore {
 
+/**@{*/
 /**
- *  \enum valueType
+ *  The size of \ref lmr_reductions. Larger depths and move numbers use
+ *  the last entry.
+ */
+constexpr int LMR_MAX_DEPTH = 64;
+constexpr int LMR_MAX_MOVES = 64;
+/**@}*/
+
+/**
+ *  Late move reductions: how many plies less to search a late quiet move,
+ *  indexed by the remaining depth and by the move's number in the node.
+ *  Filled by \ref init_reductions, don't modify it directly.
+ */
+extern uint8_t lmr_reductions[LMR_MAX_DEPTH][LMR_MAX_MOVES];
+
+/**
+ *  Fill \ref lmr_reductions. The reduction grows with the logarithms of
+ *  both the depth and the move number.
+ */
+void init_reductions();
+
+/** The half-width of the first aspiration window around a root score. */
+constexpr int ASPIRATION_WINDOW = 25;
+
+/**
+ *  Once a failed aspiration window has been widened to this half-width,
+ *  the failing side opens up to infinity.
+ */
+constexpr int ASPIRATION_MAX_WINDOW = 400;
+
+/** Iterations shallower than this search the full window. */
+constexpr int ASPIRATION_MIN_DEPTH = 4;
+
+/**
+ *  Delta pruning: the quiescence search skips a capture if winning the
+ *  captured piece, plus this margin, still wouldn't raise alpha.
+ */
+constexpr int DELTA_MARGIN = 200;
+
+/**@{*/
+/**
+ *  The deepest nodes that forward pruning is tried at, see
+ *  \ref search_options_t.
+ */
+constexpr int REVERSE_FUTILITY_DEPTH = 6;
+constexpr int RAZOR_DEPTH = 2;
+constexpr int FUTILITY_DEPTH = 3;
+constexpr int LATE_MOVE_PRUNING_DEPTH = 3;
+/**@}*/
+
+/**
+ *  \enum nodeType
  *
- *  An Enum to specify the bound flag in the transposition table.
+ *  An Enum to specify the type of a node in the search tree, see
+ *  \ref Searcher::negamax_alphabeta.
  */
-enum valueType {
-    EXACT,
-    LOWER,
-    UPPER
+enum nodeType {
+    rootNode,   /**< The root, always searched with an open window. */
+    pvNode,     /**< A node with an open window. */
+    nonPvNode   /**< A node with a null window, expected to fail. */
 };
 
 /**
- *  \struct record_t
+ *  \struct search_options_t
  *
- *  \brief A struct for recording search details, used in the transposition table.
+ *  \brief Switches for the parts of the search that can be turned off,
+ *  to compare the search with and without them.
  */
-struct record_t {
-    /** The hash value of the corresponding board state. */
-    uint64_t signature;
-    /** If available, the best move for this node. Leave = 0 if not. */
-    move_t best_move;
-    /** The depth to which this node has been searched. */
-    uint8_t depth;
-    /** The bound or value for this node. */
-    value_t score;
-    /** The full move clock of the game when this node was searched. */
-    uint8_t age;
+struct search_options_t {
+    /** Whether to use null-move pruning. */
+    bool null_move = true;
+
     /**
-     *  A flag to specify whether the score is exact, a lower bound,
-     *  or an upper bound. See \ref valueType.
+     *  Whether to check null-move cutoffs with a reduced-depth search
+     *  that doesn't itself use null moves, to guard against zugzwang.
      */
-    valueType flag;
+    bool verify_null_move = false;
+
+    /** Whether to use late move reductions. */
+    bool late_move_reductions = true;
+
+    /**
+     *  Whether to search each iteration with a narrow window around the
+     *  previous iteration's score.
+     */
+    bool aspiration_windows = true;
+
+    /**
+     *  Whether to prune shallow nodes that don't have an open window,
+     *  using the margins below.
+     */
+    bool forward_pruning = true;
+
+    /**
+     *  Reverse futility pruning: a node fails high if the static eval
+     *  beats beta by this much per ply of depth.
+     */
+    int reverse_futility_margin = 100;
+
+    /**
+     *  Razoring: a node drops into the quiescence search if the static eval
+     *  is this much per ply of depth below alpha.
+     */
+    int razor_margin = 250;
+
+    /**
+     *  Futility pruning: quiet moves are skipped if the static eval is
+     *  this much per ply of depth below alpha.
+     */
+    int futility_margin = 125;
+
+    /**
+     *  Late move pruning: quiet moves are skipped after this many moves,
+     *  plus the square of the depth.
+     */
+    int late_move_count = 3;
 };
 
 /**
- *  Pretty-print a record_t object to an output stream.
+ *  \struct search_stats_t
  *
- *  \param out      The output stream to print to.
- *  \param rec      The record_t object to print.
- *  \return         The output stream.
+ *  \brief Counters for the work done by a search.
  */
-std::ostream& operator<<(std::ostream& out, const record_t& rec);
+struct search_stats_t {
+    /** The number of nodes searched, including the quiescence search. */
+    uint64_t nodes = 0;
+
+    /** The number of those nodes in the quiescence search. */
+    uint64_t qnodes = 0;
+
+    /** The number of iterations started with an aspiration window. */
+    uint64_t aspiration_searches = 0;
+
+    /** The number of re-searches after scoring below an aspiration window. */
+    uint64_t fail_lows = 0;
+
+    /** The number of re-searches after scoring above an aspiration window. */
+    uint64_t fail_highs = 0;
+
+    /** The number of nodes cut off by reverse futility pruning. */
+    uint64_t reverse_futility_prunes = 0;
+
+    /** The number of nodes cut off by razoring. */
+    uint64_t razor_prunes = 0;
+
+    /** The number of moves skipped by futility pruning. */
+    uint64_t futility_prunes = 0;
+
+    /** The number of moves skipped by late move pruning. */
+    uint64_t late_move_prunes = 0;
+
+    /**
+     *  Add another search's counters to these ones.
+     *
+     *  \param other        The counters to add.
+     */
+    void add(const search_stats_t& other);
+};
+
+/**
+ *  \struct search_info_t
+ *
+ *  \brief The result of an iteration of iterative deepening, reported
+ *  while the search runs.
+ */
+struct search_info_t {
+    /** The depth of the iteration. */
+    int depth;
+
+    /** The score of the root, from the side to move's view. */
+    value_t score;
+
+    /** The number of nodes searched so far, over all threads. */
+    uint64_t nodes;
+
+    /** The number of seconds since the search started. */
+    double time;
+
+    /** How full the transposition table is, in parts per thousand. */
+    int hashfull;
+
+    /** The principal variation, read from the transposition table. */
+    std::vector<move_t> pv;
+};
+
+/** A function to call with each \ref search_info_t. */
+using info_callback_t = std::function<void(const search_info_t&)>;
 
 /**
  *  \class Searcher
  *  \brief A class to do all of the searching for the chess engine.
+ *
+ *  A search can use several threads (Lazy SMP). Helper Searchers search the
+ *  same position on their own copies of the board. They start at staggered
+ *  depths and share the transposition table, so each thread benefits from
+ *  the others' results. The main thread picks the move from whichever
+ *  thread completed the deepest iteration.
+ *
+ *  \ref search blocks until the search is over. \ref start_search runs it
+ *  on a worker thread instead, so that it can be stopped at any time with
+ *  \ref stop_search.
  */
 class Searcher {
  private:
@@ -71,29 +235,204 @@ class Searcher {
      */
     TransTable* trans_table;
 
-    /** The time when we started the current search. */
-    clock_t search_start_time;
+    /** Whether the Searcher allocated, and so has to delete, trans_table. */
+    bool owns_table;
+
+    /** The number of threads to search with, including the main thread. */
+    int num_threads;
+
+    /** The index of the thread running this Searcher. 0 is the main thread. */
+    int thread_id;
+
+    /** The stop flag for searches started by this Searcher. */
+    std::atomic<bool> stop_flag;
+
+    /**
+     *  The flag that ends the current search. Points to stop_flag for the
+     *  main thread, and to the main thread's stop_flag for helpers.
+     */
+    std::atomic<bool>* stop;
+
+    /** The time limits of the current search. */
+    TimeManager time_manager;
+
+    /** The deepest iteration to search, or 0 for no limit. */
+    int max_depth;
+
+    /** The number of nodes to search over all threads, or 0 for no limit. */
+    uint64_t max_nodes;
+
+    /** The node count shared by the threads of searches started here. */
+    std::atomic<uint64_t> node_counter;
+
+    /**
+     *  The node count of the current search, over all threads. Points to
+     *  node_counter for the main thread, and to the main thread's
+     *  node_counter for helpers. Only brought up to date every
+     *  TIME_CHECK_NODES nodes, see \ref count_node.
+     */
+    std::atomic<uint64_t>* total_nodes;
+
+    /** The function to report each iteration to, or empty. */
+    info_callback_t info_callback;
+
+    /** Set while searches started by this Searcher are pondering. */
+    std::atomic<bool> ponder_flag;
+
+    /**
+     *  The flag that's cleared on a ponder hit. Points to ponder_flag for
+     *  the main thread, and to the main thread's ponder_flag for helpers.
+     */
+    std::atomic<bool>* pondering;
+
+    /** The limits of the current search, to apply once pondering ends. */
+    search_limits_t limits;
+
+    /** Whether time_manager is still timing a ponder search, with no limits. */
+    bool ponder_timing;
+
+    /**
+     *  If the current search was pondering and has had a ponder hit since,
+     *  start the clock with the real limits, from now.
+     */
+    void check_ponder_hit() {
+        if (ponder_timing && !pondering->load(std::memory_order_relaxed)) {
+            ponder_timing = false;
+            time_manager.start(limits);
+        }
+    }
+
+    /** The deepest iteration this Searcher completed in the current search. */
+    uint8_t completed_depth;
+
+    /**
+     *  The killer, history and counter-move tables. Each thread keeps its
+     *  own, since they're cheap to rebuild.
+     */
+    heuristics_t heuristics;
+
+    /** The switches for the search, see \ref set_options. */
+    search_options_t options;
+
+    /**
+     *  Null moves aren't tried before this ply. Raised while verifying a
+     *  null-move cutoff, so that the verification can't cut off the same
+     *  way.
+     */
+    int null_min_ply;
+
+    /** The counters for the current search. */
+    search_stats_t stats;
+
+    /** The thread running the search started by \ref start_search. */
+    std::thread worker;
+
+    /** The move chosen by the search on the worker thread. */
+    move_t worker_move;
+
+    /**
+     *  The best move of the main thread's deepest iteration so far, for
+     *  other threads to read during the search.
+     */
+    std::atomic<move_t> best_move_so_far;
 
-    /** The time when the current search will end. */
-    clock_t search_end_time;
+    /**
+     *  Work out the late move reduction for a move. Only quiet moves
+     *  after the first few are reduced, and never in check or when the
+     *  move gives check.
+     *
+     *  \param b            The board, after the move has been made.
+     *  \param depth        The remaining depth of the node.
+     *  \param move_number  The number of the move in the node, from 1.
+     *  \param pv_node      Whether the node has an open window. These are
+     *                      reduced less.
+     *  \param in_check     Whether the side that made the move was in check.
+     *  \param gives_check  Whether the move gives check.
+     *  \param move         The move.
+     *  \return             The number of plies to reduce the search by.
+     */
+    int reduction(const Board* b, uint8_t depth, int move_number,
+                  bool pv_node, bool in_check, bool gives_check,
+                  move_t move) const;
+
+    /**
+     *  Try to cut off a node without searching its moves: by reverse
+     *  futility pruning if the static eval is far above beta, or by
+     *  razoring if it's far below alpha and the quiescence search agrees.
+     *  Only for nodes without an open window, and not in check.
+     *
+     *  \param b            The board state of the node.
+     *  \param depth        The remaining depth of the node.
+     *  \param alpha        The current value of alpha.
+     *  \param beta         The current value of beta.
+     *  \param static_eval  The static evaluation of the node, from the side
+     *                      to move's view.
+     *  \param[out] score   The value to return from the node, if pruned.
+     *  \return             True if the node can be cut off, false otherwise.
+     */
+    bool prune_node(Board* b, uint8_t depth, value_t alpha, value_t beta,
+                    value_t static_eval, value_t* score);
 
     /**
-     *  Set the search timeout.
+     *  Decide whether to skip a quiet move, by futility pruning or late
+     *  move pruning. The first move and moves that give check are always
+     *  searched. Only for nodes without an open window, and not in check.
      *
-     *  \param time     The number of seconds to search for.
+     *  \param depth        The remaining depth of the node.
+     *  \param move_number  The number of the move in the node, from 1.
+     *  \param futile       Whether the static eval is so far below alpha
+     *                      that quiet moves can't raise it.
+     *  \param gives_check  Whether the move gives check.
+     *  \param move         The move.
+     *  \return             True if the move can be skipped, false otherwise.
      */
-    void set_timeout(int time);
+    bool prune_move(uint8_t depth, int move_number, bool futile,
+                    bool gives_check, move_t move);
 
-    /** End the search, i.e. set the timeout to 0. Not yet thread-safe. */
+    /** End the search, on all threads. */
     void kill_search();
 
     /**
-     *  Prune all entries from the transposition table that are older
-     *  than a given value.
+     *  Search from a node, assuming the stop flag has already been reset.
+     *  Used by both \ref search and \ref start_search.
      *
-     *  \param age  Discard any entries older than age.
+     *  \param b            The board state of the node to be searched.
+     *  \param limits       When to stop searching.
+     *  \return             The best move to play from the current node.
+     */
+    move_t run_search(Board* b, const search_limits_t& limits);
+
+    /**
+     *  Count a node. Every TIME_CHECK_NODES nodes, add them to the shared
+     *  node count, pick up any ponder hit and look at the clock, and end
+     *  the search once the hard time limit or the node limit has passed.
      */
-    void prune_table(uint8_t age);
+    void count_node() {
+        if ((++stats.nodes & (TIME_CHECK_NODES - 1)) == 0) {
+            check_ponder_hit();
+            uint64_t total = total_nodes->fetch_add(
+                TIME_CHECK_NODES, std::memory_order_relaxed) +
+                TIME_CHECK_NODES;
+            if (time_manager.hard_limit_reached() ||
+                (max_nodes && total >= max_nodes)) {
+                kill_search();
+            }
+        }
+    }
+
+    /**
+     *  Check whether the search should end. Cheap enough to call at every
+     *  node, since the clock is only read by \ref count_node.
+     *
+     *  \return         True if the search has been stopped or has run out
+     *                  of time.
+     */
+    bool out_of_time() const {
+        return stop->load(std::memory_order_relaxed);
+    }
+
+    /** \return The number of seconds since the search started. */
+    double elapsed() const;
 
     /**
      *  \brief Perform a quiescence search on a position.
@@ -102,6 +441,11 @@ class Searcher {
      *  where we recursively search through all the upcoming capture tradeoffs
      *  to get a better heuristic value for a given position.
      *
+     *  Results are stored in the transposition table at depth 0, and the
+     *  static evaluation is taken from the table when it's there. Captures
+     *  that can't raise alpha even with \ref DELTA_MARGIN to spare are
+     *  skipped (delta pruning), unless the side to move has only pawns.
+     *
      *  \param b            The board to analyse.
      *  \param alpha        The current value of alpha in negamax search.
      *  \param beta         The current value of beta in negamax search.
@@ -110,64 +454,81 @@ class Searcher {
     value_t quiesce(Board* b, value_t alpha, value_t beta);
 
     /**
-     *  Search using Principal Variation search, to
-     *  estimate the value of the given node.
+     *  Search using the Negamax algorithm with alpha-beta pruning and
+     *  principal variation search, to estimate the value of the given node.
+     *  Only the first move of a PV node gets the full window. The others
+     *  are searched with a null window, and again with the full window if
+     *  they turn out better.
      *
+     *  Each node type compiles to its own function, so that the checks
+     *  that only apply to some node types cost nothing in the others.
+     *  Forward pruning (see \ref prune_node and \ref prune_move) and
+     *  null-move pruning are only tried at non-PV nodes. For null-move
+     *  pruning, if passing the move still fails high at a reduced depth,
+     *  so will the node. This is skipped in check, after a null move, and
+     *  when the side to move has only pawns, where zugzwang is common.
+     *
+     *  \tparam node            The type of the node, see \ref nodeType.
      *  \param b                The board state of the node to be searched.
+     *                          Moves are made and unmade on it in-place, it
+     *                          is restored before returning.
      *  \param depth            The depth to search to.
      *  \param alpha            The current value of alpha.
-     *  \param beta             The current value of beta.
+     *  \param beta             The current value of beta. Must be alpha + 1
+     *                          at a non-PV node.
+     *  \param ply              The distance of the node from the root.
+     *  \param prev_move        The move that led to the node, or 0 at the
+     *                          root.
      *  \param first_move       If given, search this move first.
      *  \return                 The estimated value of node b.
      */
-    value_t principal_variation(Board* b, uint8_t depth,
+    template <nodeType node>
+    value_t negamax_alphabeta(Board* b, uint8_t depth,
                               value_t alpha, value_t beta,
+                              int ply, move_t prev_move,
                               move_t first_move = 0);
 
     /**
-     *  Search using the Negamax algorithm with alpha-beta pruning, to
-     *  estimate the value of the given node.
+     *  Follow the best moves in the transposition table from a node.
+     *  Stops at a missing or illegal move, or after max_length moves,
+     *  which also stops it going round a repetition forever.
      *
-     *  \param b                The board state of the node to be searched.
-     *  \param depth            The depth to search to.
-     *  \param alpha            The current value of alpha.
-     *  \param beta             The current value of beta.
-     *  \param first_move       If given, search this move first.
-     *  \return                 The estimated value of node b.
+     *  \param root         The board state to start from.
+     *  \param first_move   The best move at root.
+     *  \param max_length   The most moves to return.
+     *  \return             The principal variation, starting with
+     *                      first_move.
      */
-    value_t negamax_alphabeta(Board* b, uint8_t depth,
-                              value_t alpha, value_t beta,
-                              move_t first_move = 0);
+    std::vector<move_t> get_pv(const Board& root, move_t first_move,
+                               int max_length) const;
 
     /**
-     *  Search using the Negamax algorithm to increasing depth, to
-     *  choose the best move from the current node.
+     *  Search one iteration of iterative deepening with an aspiration
+     *  window: a narrow window around the previous iteration's score, which
+     *  cuts off far more than the full window does. If the score falls
+     *  outside the window, the failing side is widened, more each time,
+     *  and the iteration searched again.
      *
-     *  \param b            The board state of the node to be searched.
-     *  \param timeout      The maximum time to spend searching.
-     *  \param cutoff       A boolean indicating whether or not to
-     *                      end the search early if we find the same
-     *                      best move several times in a row.
-     *  \return             The best move to play from the current node.
+     *  \param b            The board state of the root node.
+     *  \param depth        The depth to search to.
+     *  \param prev_score   The score of the previous iteration.
+     *  \param first_move   The best move of the previous iteration, or 0.
+     *  \return             The score of the root node.
      */
-    move_t iterative_deepening_negamax(Board* b,
-                                       int timeout,
-                                       bool cutoff = false);
+    value_t aspiration_search(Board* b, uint8_t depth, value_t prev_score,
+                              move_t first_move);
 
     /**
-     *  Search using the Prinicpal Variation algorithm to increasing depth, to
-     *  choose the best move from the current node.
+     *  Search using the Negamax algorithm to increasing depth, to
+     *  choose the best move from the current node. The time manager must
+     *  already have been started. The main thread stops between iterations
+     *  once \ref TimeManager::soft_limit_reached, the helpers only when
+     *  the search is stopped.
      *
      *  \param b            The board state of the node to be searched.
-     *  \param timeout      The maximum time to spend searching.
-     *  \param cutoff       A boolean indicating whether or not to
-     *                      end the search early if we find the same
-     *                      best move several times in a row.
      *  \return             The best move to play from the current node.
      */
-    move_t iterative_deepening_pv(Board* b,
-                                  int timeout,
-                                  bool cutoff = false);
+    move_t iterative_deepening_negamax(Board* b);
 
  public:
     /**
@@ -177,6 +538,7 @@ class Searcher {
 
     /**
      *  Constructor for Searcher. Supply an existing transposition table.
+     *  The table is not deleted with the Searcher.
      *
      *  \param tt           A pointer to the transposition table to use.
      */
@@ -185,17 +547,124 @@ class Searcher {
     /** Destructor for Searcher. */
     virtual ~Searcher();
 
+    /**
+     *  Set the number of threads to search with.
+     *
+     *  \param n            The number of threads, including the main thread.
+     *                      Values less than 1 are treated as 1.
+     */
+    void set_threads(int n);
+
+    /**
+     *  Set the switches for the search. Takes effect from the next search.
+     *
+     *  \param opts         The switches to use.
+     */
+    void set_options(const search_options_t& opts);
+
+    /** \return The switches for the search. */
+    const search_options_t& get_options() const;
+
+    /**
+     *  Forget everything learned from earlier searches: clear the
+     *  transposition table and the history and counter-move tables. Must
+     *  not be called while a search is running.
+     */
+    void new_game();
+
+    /**
+     *  \return The counters for the latest search, summed over all the
+     *          threads once it has finished.
+     */
+    const search_stats_t& get_stats() const;
+
     /**
      *  Search from a node for the best move to play.
+     *  The search runs on a private copy of b, making and unmaking moves
+     *  in-place, so b itself is left untouched. Helper threads are started
+     *  and joined within the call.
      *
      *  \param b            The board state of the node to be searched.
-     *  \param timeout      The maximum time to spend searching.
+     *  \param limits       When to stop searching.
+     *  \return             The best move to play from the current node.
+     */
+    move_t search(Board* b, const search_limits_t& limits);
+
+    /**
+     *  Search from a node for the best move to play, for a number of
+     *  seconds.
+     *
+     *  \param b            The board state of the node to be searched.
+     *  \param timeout      The maximum time to spend searching, in seconds.
      *  \param cutoff       A boolean indicating whether or not to
-     *                      end the search early if we find the same
-     *                      best move several times in a row.
+     *                      end the search early once the best move has
+     *                      been the same for several iterations.
      *  \return             The best move to play from the current node.
      */
     move_t search(Board* b, int timeout, bool cutoff = false);
+
+    /**
+     *  Start searching a node on a worker thread, and return at once.
+     *  A search that's already running is stopped first. Only one thread
+     *  should start, stop and wait for the searches of a Searcher.
+     *
+     *  \param b            The board state of the node to be searched. The
+     *                      search runs on a copy, so b can change or go away
+     *                      while it runs.
+     *  \param limits       When to stop searching.
+     */
+    void start_search(const Board& b, const search_limits_t& limits);
+
+    /**
+     *  Stop the current search, on all threads. Returns at once: the
+     *  threads stop within a node, and \ref wait collects the result.
+     *  Safe to call from any thread, and when no search is running.
+     */
+    void stop_search();
+
+    /**
+     *  Wait for the search started by \ref start_search to finish, either
+     *  by reaching its limits or by being stopped.
+     *
+     *  \return             The best move found, or 0 if no search was
+     *                      started.
+     */
+    move_t wait();
+
+    /**
+     *  Set a function to call after each iteration of iterative deepening,
+     *  on the main search thread. Takes effect from the next search.
+     *
+     *  \param callback     The function, or an empty function for none.
+     */
+    void set_info_callback(info_callback_t callback);
+
+    /**
+     *  Tell a pondering search that the opponent played the expected move:
+     *  the search carries on, keeping everything it has found, but the
+     *  clock starts now with the search's real limits. Safe to call from
+     *  any thread.
+     */
+    void ponder_hit();
+
+    /**
+     *  Get the best move the transposition table has for a position, for
+     *  instance to guess the opponent's reply to our move and ponder on it.
+     *
+     *  \param b            The position.
+     *  \return             The move, or 0 if there's no legal one stored.
+     */
+    move_t expected_move(const Board& b) const;
+
+    /** \return True if a search started by \ref start_search is running. */
+    bool searching() const;
+
+    /**
+     *  \return The best move of the deepest iteration finished so far in
+     *          the current search, or 0 if none has finished. Safe to call
+     *          from any thread while the search runs.
+     */
+    move_t get_best_move() const;
 };
 
 
@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_CORE_SELFTEST_H_
+#define SRC_CORE_SELFTEST_H_
+
+#include <iostream>
+
+
+namespace chessCore {
+
+/** The number of random occupancies each slider backend is checked on. */
+constexpr int SLIDER_TEST_OCCUPANCIES = 200000;
+
+/**
+ *  Check the slider attack tables against the ray walker: for random
+ *  occupancies and every square, \ref rookAttacks, \ref bishopAttacks and
+ *  \ref queenAttacks must match \ref rookPushNaive, \ref bishopPushNaive
+ *  and \ref queenPushNaive. Checks each backend the CPU supports, and
+ *  leaves the selected backend as it was.
+ *
+ *  \param out          The stream to write the report to.
+ *  \return             True if every lookup matched.
+ */
+bool test_slider_attacks(std::ostream& out = std::cout);
+
+/**@{*/
+/**
+ *  The timing of the slider backend speed test: the fastest of
+ *  SLIDER_SPEED_RUNS perfts of kiwipete to SLIDER_SPEED_DEPTH is kept for
+ *  each backend.
+ */
+constexpr int SLIDER_SPEED_RUNS = 5;
+constexpr int SLIDER_SPEED_DEPTH = 3;
+/**@}*/
+
+/** How much slower, in percent, the selected backend may time, for noise. */
+constexpr int SLIDER_SPEED_TOLERANCE = 5;
+
+/**
+ *  Check that the slider backend chosen by \ref init_magics is not slower
+ *  than the magic multiplication fallback. Times move generation rather
+ *  than bare lookups, which hide the cost of an out-of-line call.
+ *
+ *  \param out          The stream to write the report to.
+ *  \return             True if the selected backend is at least as fast,
+ *                      within SLIDER_SPEED_TOLERANCE.
+ */
+bool test_slider_backend_speed(std::ostream& out = std::cout);
+
+/**@{*/
+/** The shape of the transposition table stress test. */
+constexpr int TABLE_STRESS_THREADS = 8;
+constexpr int TABLE_STRESS_POSITIONS = 16;
+constexpr int TABLE_STRESS_OPERATIONS = 1000000;
+/**@}*/
+
+/**
+ *  Stress the lock-free transposition table: several threads save and
+ *  probe a handful of positions that all share one bucket. Every field of
+ *  a record is derived from its hash, so each probe that hits can be
+ *  checked for a record torn between two writers.
+ *
+ *  \param out          The stream to write the report to.
+ *  \return             True if every record probed was consistent.
+ */
+bool test_table_concurrency(std::ostream& out = std::cout);
+
+/** The depth of the first search in the table aging test. */
+constexpr int TABLE_AGING_DEPTH = 8;
+
+/**
+ *  Check that records from the previous search still produce cutoffs:
+ *  search a position, play the best move and the expected reply, and
+ *  search the result two plies shallower. The record from the first
+ *  search must still be there, and the second search must take far fewer
+ *  nodes on the kept table than on an empty one.
+ *
+ *  \param out          The stream to write the report to.
+ *  \return             True if the old records were kept and used.
+ */
+bool test_table_aging(std::ostream& out = std::cout);
+
+/**
+ *  Run all the self-tests. \ref init must have been called first.
+ *
+ *  \param out          The stream to write the report to.
+ *  \return             The number of tests that failed.
+ */
+int run_selftests(std::ostream& out = std::cout);
+
+}   // namespace chessCore
+
+#endif  // SRC_CORE_SELFTEST_H_
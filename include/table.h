@@ -0,0 +1,347 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_CORE_TABLE_H_
+#define SRC_CORE_TABLE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+#include "typedefs.h"
+
+
+namespace chessCore {
+
+/**
+ *  \enum valueType
+ *
+ *  An Enum to specify the bound flag in the transposition table.
+ *  0 is not a valid flag, it marks an empty record.
+ */
+enum valueType : uint8_t {
+    EXACT = 1,
+    LOWER,
+    UPPER
+};
+
+/** The number of distinct search generations a \ref record_t can hold. */
+constexpr int NUM_GENERATIONS = 64;
+
+/**
+ *  \struct record_t
+ *
+ *  \brief A struct for recording search details, used in the transposition table.
+ *
+ *  Records are packed into 10 bytes, so that six of them fit in a cache
+ *  line. Only the top 16 bits of the hash are kept: the bottom bits are
+ *  implied by the bucket the record is stored in.
+ */
+struct record_t {
+    /** The top 16 bits of the hash value of the corresponding board state. */
+    uint16_t key;
+    /** If available, the best move for this node. Leave = 0 if not. */
+    move_t best_move;
+    /** The bound or value for this node. */
+    value_t score;
+    /** The static evaluation of the node, from the side to move's view. */
+    value_t eval;
+    /** The depth to which this node has been searched. */
+    uint8_t depth;
+    /**
+     *  The generation of the search that stored the record (see
+     *  \ref TransTable::new_search) in the top 6 bits, and the bound
+     *  flag (see \ref valueType) in the bottom 2 bits.
+     */
+    uint8_t gen_bound;
+
+    /** \return The bound flag of the record. */
+    valueType flag() const { return valueType(gen_bound & 3); }
+
+    /** \return The generation of the record. */
+    uint8_t generation() const { return gen_bound >> 2; }
+};
+
+static_assert(sizeof(record_t) == 10, "a record should pack into 10 bytes");
+
+/**
+ *  Get the part of a hash value that's stored in a \ref record_t.
+ *
+ *  \param hash     The hash value of the board state.
+ *  \return         The top 16 bits of hash.
+ */
+inline uint16_t record_key(uint64_t hash) {
+    return static_cast<uint16_t>(hash >> 48);
+}
+
+/**
+ *  Pack everything but the key of a record into a 64-bit word.
+ *
+ *  \param rec      The record to pack.
+ *  \return         The packed record.
+ */
+inline uint64_t pack_data(const record_t& rec) {
+    return uint64_t(rec.best_move) |
+           (uint64_t(uint16_t(rec.score)) << 16) |
+           (uint64_t(uint16_t(rec.eval)) << 32) |
+           (uint64_t(rec.depth) << 48) |
+           (uint64_t(rec.gen_bound) << 56);
+}
+
+/**
+ *  Unpack a record from its key and a word made by \ref pack_data.
+ *
+ *  \param key      The key of the record.
+ *  \param data     The packed record.
+ *  \return         The record.
+ */
+inline record_t unpack_data(uint16_t key, uint64_t data) {
+    record_t rec;
+    rec.key = key;
+    rec.best_move = static_cast<move_t>(data);
+    rec.score = static_cast<value_t>(data >> 16);
+    rec.eval = static_cast<value_t>(data >> 32);
+    rec.depth = static_cast<uint8_t>(data >> 48);
+    rec.gen_bound = static_cast<uint8_t>(data >> 56);
+    return rec;
+}
+
+/**
+ *  Fold a packed record into 16 bits, to check it against its key.
+ *
+ *  \param data     The packed record.
+ *  \return         The XOR of the four 16-bit words of data.
+ */
+inline uint16_t fold_data(uint64_t data) {
+    return static_cast<uint16_t>(data ^ (data >> 16) ^
+                                 (data >> 32) ^ (data >> 48));
+}
+
+/**
+ *  Pretty-print a record_t object to an output stream.
+ *
+ *  \param out      The output stream to print to.
+ *  \param rec      The record_t object to print.
+ *  \return         The output stream.
+ */
+std::ostream& operator<<(std::ostream& out, const record_t& rec);
+
+/** The number of records in one bucket of a \ref TransTable. */
+constexpr int BUCKET_SIZE = 6;
+
+/**
+ *  \struct bucket_t
+ *
+ *  \brief A cache line of records sharing the same table index.
+ *
+ *  The first BUCKET_SIZE - 1 slots are depth-preferred, the last slot is
+ *  always replaced.
+ *
+ *  Each record is split into its key and a 64-bit word holding the rest,
+ *  so that both halves can be read and written atomically without locks.
+ *  The key is stored XORed with a 16-bit fold of the data word. If two
+ *  threads write the same slot at once, the slot can end up with the key
+ *  of one record and the data of the other. The stored key then no longer
+ *  matches its data, and the slot is treated as empty.
+ */
+struct alignas(64) bucket_t {
+    /** The keys of the records, XORed with \ref fold_data of the data. */
+    std::atomic<uint16_t> keys[BUCKET_SIZE];
+    /**
+     *  The table epoch the bucket was last written in. A bucket from an
+     *  earlier epoch is treated as empty.
+     */
+    std::atomic<uint8_t> epoch;
+    /** The records without their keys, see \ref pack_data. */
+    std::atomic<uint64_t> data[BUCKET_SIZE];
+};
+
+static_assert(sizeof(bucket_t) == 64, "a bucket should fill one cache line");
+
+/** The default size of a \ref TransTable, in megabytes. */
+constexpr size_t DEFAULT_TABLE_MB = 16;
+
+/**
+ *  \class TransTable
+ *  \brief A fixed-size hash table of search results.
+ *
+ *  The table is allocated once, as a power-of-two number of 64-byte
+ *  buckets, and never grows. A position is stored in the bucket given by
+ *  the low bits of its hash, and identified within the bucket by the top
+ *  16 bits. Clearing the table just bumps an epoch counter, which makes
+ *  every bucket stale.
+ *
+ *  Each search bumps a generation counter instead of sweeping the table.
+ *  Records from earlier searches stay usable, but are replaced first.
+ *
+ *  \ref probe and \ref save can be called from several threads at once,
+ *  and don't take any locks (see \ref bucket_t). The other methods must
+ *  only be called while no search is running.
+ */
+class TransTable {
+ private:
+    /** The raw allocation, large enough to align the buckets. */
+    char* memory;
+
+    /** The buckets. Points into \ref memory. */
+    bucket_t* buckets;
+
+    /** The number of buckets. Always a power of two. */
+    size_t num_buckets;
+
+    /** The current epoch. Buckets from other epochs are empty. */
+    uint8_t epoch;
+
+    /** The generation of the current search, see \ref new_search. */
+    uint8_t generation;
+
+    /**
+     *  Allocate the buckets, discarding any previous contents.
+     *
+     *  \param n            The number of buckets. Must be a power of two.
+     */
+    void allocate(size_t n);
+
+    /**
+     *  Find the bucket for a given hash.
+     *
+     *  \param hash         The hash of the position.
+     *  \return             A pointer to the bucket.
+     */
+    bucket_t* bucket(uint64_t hash) const {
+        return buckets + (hash & (num_buckets - 1));
+    }
+
+    /**
+     *  Check whether a bucket has been written since the last clear.
+     *
+     *  \param b            The bucket to check.
+     *  \return             True if the bucket is in use.
+     */
+    bool is_valid(const bucket_t& b) const {
+        return b.epoch.load(std::memory_order_relaxed) == epoch;
+    }
+
+    /**
+     *  Get how many searches ago a record was stored.
+     *
+     *  \param rec          The record to check.
+     *  \return             0 if the record is from the current search, and
+     *                      up to NUM_GENERATIONS - 1 for older records.
+     */
+    int relative_age(const record_t& rec) const {
+        return (NUM_GENERATIONS + generation - rec.generation()) %
+               NUM_GENERATIONS;
+    }
+
+ public:
+    /** Construct a table of the default size. */
+    TransTable();
+
+    /**
+     *  Construct a table of a given size.
+     *
+     *  \param mb           The size of the table, in megabytes. Rounded down
+     *                      to a power of two.
+     */
+    explicit TransTable(size_t mb);
+
+    /**
+     *  Copy constructor for TransTable.
+     *
+     *  \param other        The TransTable object to copy.
+     */
+    TransTable(const TransTable& other);
+
+    /**
+     *  Assignment operator for TransTable.
+     *
+     *  \param other        RHS TransTable object to copy.
+     *  \return             Self.
+     */
+    TransTable& operator=(const TransTable& other);
+
+    /** Destructor for TransTable. */
+    ~TransTable();
+
+    /**
+     *  Resize the table, discarding its contents.
+     *
+     *  \param mb           The new size of the table, in megabytes. Rounded
+     *                      down to a power of two.
+     */
+    void resize(size_t mb);
+
+    /** Empty the table in constant time. */
+    void clear();
+
+    /**
+     *  Start a new search. Records from earlier searches are kept, and can
+     *  still be probed, but become the first to be replaced.
+     *  Takes constant time.
+     */
+    void new_search();
+
+    /**
+     *  Look up a position in the table.
+     *
+     *  \param hash         The hash of the position.
+     *  \param[out] rec     The record for the position, if found.
+     *  \return             True if the position was found, false otherwise.
+     */
+    bool probe(uint64_t hash, record_t* rec) const;
+
+    /**
+     *  Store a record. An existing record for the same position is
+     *  overwritten. Otherwise the record replaces the least valuable
+     *  depth-preferred record in the bucket, counting older searches
+     *  against a record's depth. A record from an earlier search is always
+     *  replaced; one from the current search only if the new record was
+     *  searched at least as deep. If neither, the always-replace record
+     *  is used.
+     *
+     *  \param hash         The hash of the position.
+     *  \param best_move    The best move, or 0 if not known.
+     *  \param score        The bound or value for the position.
+     *  \param eval         The static evaluation of the position.
+     *  \param depth        The depth the position was searched to.
+     *  \param flag         The bound flag of score.
+     */
+    void save(uint64_t hash, move_t best_move, value_t score, value_t eval,
+              uint8_t depth, valueType flag);
+
+    /** \return The number of records the table can hold. */
+    size_t capacity() const;
+
+    /** \return The number of records in use. Walks the whole table. */
+    size_t size() const;
+
+    /**
+     *  Estimate how full the table is with records from the current search,
+     *  from a sample of the first thousand or so records.
+     *
+     *  \return             The estimate, in parts per thousand.
+     */
+    int hashfull() const;
+
+    /**
+     *  Access a record slot by position, for iterating over the table.
+     *
+     *  \param i            The slot, from 0 to \ref capacity() - 1.
+     *  \param[out] hash    A hash that maps to the record in slot i: the
+     *                      bucket index in the low bits and the record key
+     *                      in the top bits.
+     *  \param[out] rec     The record in slot i, if it is in use.
+     *  \return             True if slot i is in use, false otherwise.
+     */
+    bool at(size_t i, uint64_t* hash, record_t* rec) const;
+};
+
+}   // namespace chessCore
+
+#endif  // SRC_CORE_TABLE_H_
@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_CORE_TIMEMAN_H_
+#define SRC_CORE_TIMEMAN_H_
+
+#include <chrono>
+#include <cstdint>
+
+
+namespace chessCore {
+
+/** The clock used to time searches. */
+using search_clock = std::chrono::steady_clock;
+
+/**
+ *  The number of nodes each thread searches between looks at the clock.
+ *  Must be a power of 2.
+ */
+constexpr uint64_t TIME_CHECK_NODES = 1024;
+
+/**
+ *  The time in milliseconds kept back from the clock for each move, to
+ *  cover the time it takes to send the move.
+ */
+constexpr int64_t MOVE_OVERHEAD = 50;
+
+/**
+ *  The number of moves the remaining time is shared between, when there's
+ *  no time control to reach or it's further away than this.
+ */
+constexpr int DEFAULT_MOVES_TO_GO = 30;
+
+/**
+ *  \struct search_limits_t
+ *
+ *  \brief When to stop a search. All times are in milliseconds, and limits
+ *  that are 0 don't apply. A search with no limits at all runs until it's
+ *  stopped.
+ */
+struct search_limits_t {
+    /** The time left on our clock. */
+    int64_t time_left = 0;
+
+    /** The time added to our clock after each move. */
+    int64_t increment = 0;
+
+    /** The number of moves to play before more time is added. */
+    int moves_to_go = 0;
+
+    /** The exact time to search for. */
+    int64_t move_time = 0;
+
+    /**
+     *  The longest time to search for. The search stops sooner if the best
+     *  move stays the same over several iterations.
+     */
+    int64_t max_time = 0;
+
+    /** The deepest iteration to search. */
+    int depth = 0;
+
+    /**
+     *  The number of nodes to search, over all threads. Checked every
+     *  TIME_CHECK_NODES nodes, so the search can overshoot by that much
+     *  per thread.
+     */
+    uint64_t nodes = 0;
+
+    /** Whether to ignore the time limits and search until stopped. */
+    bool infinite = false;
+
+    /**
+     *  Whether to ponder: search on the opponent's time, ignoring the time
+     *  limits until \ref Searcher::ponder_hit.
+     */
+    bool ponder = false;
+};
+
+/**
+ *  \class TimeManager
+ *  \brief Decides how long a search should take, using a wall clock so
+ *  that it doesn't matter how many threads are searching.
+ *
+ *  There are two limits. The hard limit is checked during the search,
+ *  and stops it as soon as it passes. The soft limit is only checked
+ *  between iterations of iterative deepening. It's stretched when the best
+ *  move has just changed, and shrunk when the best move has stayed the
+ *  same for a while.
+ */
+class TimeManager {
+ private:
+    /** The time when the search started. */
+    search_clock::time_point start_time;
+
+    /**
+     *  The time to aim for, before adjusting for the best move's stability,
+     *  or zero to only stop at the hard limit.
+     */
+    search_clock::duration soft_limit;
+
+    /** The time when the search must stop. */
+    search_clock::time_point hard_deadline;
+
+    /** Whether there's no time limit at all. */
+    bool unlimited;
+
+ public:
+    /** Constructor for TimeManager. The clock starts with no limits. */
+    TimeManager();
+
+    /**
+     *  Start the clock for a new search, and work out its limits.
+     *
+     *  \param limits       The limits of the search.
+     */
+    void start(const search_limits_t& limits);
+
+    /**
+     *  Check the hard limit. Reads the clock, so call it every
+     *  TIME_CHECK_NODES nodes rather than at every node.
+     *
+     *  \return             True if the search must stop now.
+     */
+    bool hard_limit_reached() const;
+
+    /**
+     *  Decide whether to start another iteration of iterative deepening.
+     *
+     *  \param stability    The number of iterations in a row that the best
+     *                      move hasn't changed for.
+     *  \return             True if the search should stop.
+     */
+    bool soft_limit_reached(int stability) const;
+
+    /** \return The number of seconds since the search started. */
+    double elapsed() const;
+};
+
+}   // namespace chessCore
+
+#endif  // SRC_CORE_TIMEMAN_H_
@@ -8,14 +8,39 @@ LICENSE file in the root directory of this source tree.
 #ifndef SRC_CORE_TWIDDLE_H_
 #define SRC_CORE_TWIDDLE_H_
 
-#include <math.h>
+#if __cplusplus >= 202002L
+#include <bit>
+#endif
+
 #include "typedefs.h"
 
+// pick the fastest available implementation of the bit scans:
+// C++20 <bit>, then the GCC/Clang builtins, then portable de Bruijn
+// multiplication. All three are usable in constant expressions.
+#if __cplusplus >= 202002L && defined(__cpp_lib_bitops)
+#define CHESSCORE_BITOPS_STD 1
+#elif defined(__GNUC__) || defined(__clang__)
+#define CHESSCORE_BITOPS_BUILTIN 1
+#endif
+
 namespace chessCore {
 
 #define FSB first_set_bit
+
+/**
+ *  Loop over the indices of the set bits of a bitboard, from least to most
+ *  significant. The bitboard is consumed: it is zero after the loop.
+ *
+ *  \code
+ *  bitboard tmp = pieceBoards[whiteKnight];
+ *  int sq;
+ *  ITER_BITBOARD(sq, tmp) {
+ *      // do something with sq
+ *  }
+ *  \endcode
+ */
 #define ITER_BITBOARD(ind, bb) \
-    for (ind = FSB(bb); bb; bb &= (bb - 1ULL), ind = FSB(bb))
+    while ((bb) && ((ind = pop_lsb(&(bb))), true))
 
 
 /**@{*/
@@ -63,6 +88,23 @@ constexpr bitboard notRankEight = ~rankEight;
 /**@}*/
 
 
+#if !defined(CHESSCORE_BITOPS_STD) && !defined(CHESSCORE_BITOPS_BUILTIN)
+/** The de Bruijn sequence used for the portable bit scans. */
+constexpr bitboard debruijn64 = 0x03f79d71b4cb0a89ULL;
+
+/** Map the top 6 bits of a de Bruijn product to a bit index. */
+constexpr int debruijn_index64[64] = {
+     0, 47,  1, 56, 48, 27,  2, 60,
+    57, 49, 41, 37, 28, 16,  3, 61,
+    54, 58, 35, 52, 50, 42, 21, 44,
+    38, 32, 29, 23, 17, 11,  4, 62,
+    46, 55, 26, 59, 40, 36, 15, 53,
+    34, 51, 20, 43, 31, 22, 10, 45,
+    25, 39, 14, 33, 19, 30,  9, 24,
+    13, 18,  8, 12,  7,  6,  5, 63
+};
+#endif
+
 /**
  *  Count the number of bits set in a bitboard.
  *
@@ -70,32 +112,70 @@ constexpr bitboard notRankEight = ~rankEight;
  *  \return             The number of bits set in v.
  */
 constexpr int count_bits_set(bitboard v) {
+#if defined(CHESSCORE_BITOPS_STD)
+    return std::popcount(v);
+#elif defined(CHESSCORE_BITOPS_BUILTIN)
+    return __builtin_popcountll(v);
+#else
     // thanks Brian Kernighan
     int c = 0;
     for (; v; c++) {
         v &= v - 1;
     }
     return c;
+#endif
 }
 
 /**
  *  Return the index of the first (rightmost) set bit in a bitboard.
  *
- *  \param v            The bitboard.
+ *  \param v            The bitboard. Must be non-zero.
  *  \return             The index of the first bit set in v.
  */
 constexpr int first_set_bit(bitboard v) {
-    return log2(v & -v);
+#if defined(CHESSCORE_BITOPS_STD)
+    return std::countr_zero(v);
+#elif defined(CHESSCORE_BITOPS_BUILTIN)
+    return __builtin_ctzll(v);
+#else
+    return debruijn_index64[((v ^ (v - 1)) * debruijn64) >> 58];
+#endif
 }
 
 /**
  *  Return the index of the last (leftmost) set bit in a bitboard.
  *
- *  \param v            The bitboard.
+ *  \param v            The bitboard. Must be non-zero.
  *  \return             The index of the last bit set in v.
  */
 constexpr int last_set_bit(bitboard v) {
-    return log2(v);
+#if defined(CHESSCORE_BITOPS_STD)
+    return 63 - std::countl_zero(v);
+#elif defined(CHESSCORE_BITOPS_BUILTIN)
+    return 63 - __builtin_clzll(v);
+#else
+    // smear the leftmost bit all the way to the right
+    v |= v >> 1;
+    v |= v >> 2;
+    v |= v >> 4;
+    v |= v >> 8;
+    v |= v >> 16;
+    v |= v >> 32;
+    return debruijn_index64[(v * debruijn64) >> 58];
+#endif
+}
+
+/**
+ *  Return the index of the first (rightmost) set bit in a bitboard, and
+ *  unset it. Used by \ref ITER_BITBOARD.
+ *
+ *  \param v            A pointer to the bitboard. Must be non-zero.
+ *  \return             The index of the bit that was unset.
+ */
+constexpr int pop_lsb(bitboard* v) {
+    int i = first_set_bit(*v);
+    *v &= *v - 1;
+    return i;
 }
 
 /**
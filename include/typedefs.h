@@ -8,11 +8,12 @@ LICENSE file in the root directory of this source tree.
 #ifndef SRC_CORE_TYPEDEFS_H_
 #define SRC_CORE_TYPEDEFS_H_
 
+#include <assert.h>
+
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <limits>
-#include <unordered_map>
-#include <vector>
 
 namespace chessCore {
 
@@ -31,8 +32,90 @@ constexpr value_t VAL_INFINITY = std::numeric_limits<value_t>::max() - 10;
 /** A 16-bit unsigned integer representing a single move. */
 using move_t = uint16_t;
 
-/** A move_t vector for move generation and reordering. */
-using MoveList = std::vector<move_t>;
+/**
+ *  The capacity of a \ref MoveList. No legal position has more than
+ *  218 moves.
+ */
+constexpr int MAX_MOVES = 256;
+
+/**
+ *  \class MoveList
+ *  \brief A fixed-capacity move_t array for move generation and reordering.
+ *
+ *  Moves are generated at every node of the search, so the list lives
+ *  entirely on the stack rather than allocating like a std::vector.
+ *  Provides the parts of the std::vector interface used by the engine:
+ *  iteration, indexing, push_back, size and empty.
+ */
+class MoveList {
+    /** The moves in the list. Only the first \ref count are valid. */
+    move_t moves[MAX_MOVES];
+
+    /** The number of moves in the list. */
+    int count;
+
+ public:
+    /** Random-access iterators over the moves. */
+    using iterator = move_t*;
+    using const_iterator = const move_t*;
+
+    /** Construct an empty list. */
+    MoveList() : count(0) {}
+
+    /**
+     *  Copy constructor for MoveList. Only copies the valid moves.
+     *
+     *  \param other    The MoveList object to be copied.
+     */
+    MoveList(const MoveList& other) : count(other.count) {
+        std::copy(other.moves, other.moves + count, moves);
+    }
+
+    /**
+     *  Assignment operator for MoveList. Only copies the valid moves.
+     *
+     *  \param other    RHS MoveList object to copy.
+     *  \return         Self.
+     */
+    MoveList& operator=(const MoveList& other) {
+        count = other.count;
+        std::copy(other.moves, other.moves + count, moves);
+        return *this;
+    }
+
+    /**
+     *  Add a move to the end of the list.
+     *
+     *  \param move     The move to add.
+     */
+    void push_back(move_t move) {
+        assert(count < MAX_MOVES);
+        moves[count++] = move;
+    }
+
+    /** Remove all the moves from the list. */
+    void clear() { count = 0; }
+
+    /** \return The number of moves in the list. */
+    int size() const { return count; }
+
+    /** \return True if the list has no moves, false otherwise. */
+    bool empty() const { return count == 0; }
+
+    /**@{*/
+    /** Access the move at a given index. */
+    move_t& operator[](int i) { return moves[i]; }
+    const move_t& operator[](int i) const { return moves[i]; }
+    /**@}*/
+
+    /**@{*/
+    /** Iterators to the start and end of the list. */
+    iterator begin() { return moves; }
+    iterator end() { return moves + count; }
+    const_iterator begin() const { return moves; }
+    const_iterator end() const { return moves + count; }
+    /**@}*/
+};
 
 /**
  *  \enum colour
@@ -102,10 +185,8 @@ enum direction {
     dirNW
 };
 
-struct record_t;
-
-/** A hash map used for search. */
-using TransTable = std::unordered_map<uint32_t, record_t>;
+/** The transposition table used for search. Defined in table.h. */
+class TransTable;
 
 
 }   // namespace chessCore
@@ -0,0 +1,36 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#ifndef SRC_CORE_UCI_H_
+#define SRC_CORE_UCI_H_
+
+#include <iostream>
+
+
+namespace chessCore {
+
+/**
+ *  Run the engine under the Universal Chess Interface (UCI), reading
+ *  commands until "quit" or the end of the input. \ref init must have been
+ *  called first.
+ *
+ *  Supports uci, isready, ucinewgame, setoption (Hash, Threads, Ponder
+ *  and the forward pruning tunables), position (startpos or fen, with
+ *  moves), go (depth, nodes, movetime, wtime, btime, winc, binc,
+ *  movestogo, infinite and ponder), ponderhit, stop and quit. Searches
+ *  run in the background, so that stop and isready are answered at once,
+ *  and report an info line after each iteration. The best move comes with
+ *  the expected reply to ponder on.
+ *
+ *  \param in           The stream to read commands from.
+ *  \param out          The stream to write responses to.
+ */
+void uci_loop(std::istream& in = std::cin, std::ostream& out = std::cout);
+
+}   // namespace chessCore
+
+#endif  // SRC_CORE_UCI_H_
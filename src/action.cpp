@@ -723,6 +723,120 @@ void Board::doMoveInPlace(move_t move) {
     sideToMove = otherColour;
 }
 
+void Board::makeMove(move_t move, undo_t* undo) {
+    int toSquare = to_sq(move);
+    colour otherColour = flipColour(sideToMove);
+
+    undo->captured = -1;
+    if (is_ep_capture(move)) {
+        undo->captured = 6 * otherColour;
+    } else if (is_capture(move)) {
+        for (int i = 6 * otherColour; i < 6 * (1 + otherColour); i++) {
+            if (is_bit_set(pieceBoards[i], toSquare)) {
+                undo->captured = i;
+                break;
+            }
+        }
+    }
+
+    getCastlingRights(undo->castling);
+    undo->ep = lastMoveDoublePawnPush;
+    undo->dpp = dPPFile;
+    undo->halfMoveClock = halfMoveClock;
+    undo->fullMoveClock = fullMoveClock;
+    undo->opening_value = opening_value;
+    undo->endgame_value = endgame_value;
+    undo->hash_value = hash_value;
+
+    Board::doMoveInPlace(move);
+}
+
+void Board::unmakeMove(move_t move, const undo_t& undo) {
+    int i;
+    uint16_t fromSquare = from_sq(move);
+    uint16_t toSquare = to_sq(move);
+    bitboard fromBB = 1ULL << fromSquare;
+    bitboard toBB = 1ULL << toSquare;
+
+    // the side that made the move
+    sideToMove = flipColour(sideToMove);
+
+    if (is_promotion(move)) {
+        pieceBoards[(6 * sideToMove) + which_promotion(move)] &= ~toBB;
+        pieceBoards[6 * sideToMove] |= fromBB;
+    } else {
+        for (i = sideToMove * 6; i < (1 + sideToMove) * 6; i++) {
+            if (pieceBoards[i] & toBB) {
+                pieceBoards[i] = (pieceBoards[i] & ~toBB) | fromBB;
+                break;
+            }
+        }
+    }
+
+    if (is_kingCastle(move)) {
+        pieceBoards[1 + (6 * sideToMove)] =
+                        (pieceBoards[1 + (6 * sideToMove)] &
+                        ~(1ULL << (toSquare - 1))) |
+                        (1ULL << (fromSquare + 3));
+    } else if (is_queenCastle(move)) {
+        pieceBoards[1 + (6 * sideToMove)] =
+                        (pieceBoards[1 + (6 * sideToMove)] &
+                        ~(1ULL << (toSquare + 1))) |
+                        (1ULL << (fromSquare - 4));
+    }
+
+    if (undo.captured != -1) {
+        if (is_ep_capture(move)) {
+            int _dir = (sideToMove == white) ? S : N;
+            pieceBoards[undo.captured] |= (1ULL << (toSquare + _dir));
+        } else {
+            pieceBoards[undo.captured] |= toBB;
+        }
+    }
+
+    castleWhiteKingSide = undo.castling[0];
+    castleWhiteQueenSide = undo.castling[1];
+    castleBlackKingSide = undo.castling[2];
+    castleBlackQueenSide = undo.castling[3];
+    lastMoveDoublePawnPush = undo.ep;
+    dPPFile = undo.dpp;
+    halfMoveClock = undo.halfMoveClock;
+    fullMoveClock = undo.fullMoveClock;
+    opening_value = undo.opening_value;
+    endgame_value = undo.endgame_value;
+    hash_value = undo.hash_value;
+}
+
+void Board::makeNullMove(undo_t* undo) {
+    undo->captured = -1;
+    getCastlingRights(undo->castling);
+    undo->ep = lastMoveDoublePawnPush;
+    undo->dpp = dPPFile;
+    undo->halfMoveClock = halfMoveClock;
+    undo->fullMoveClock = fullMoveClock;
+    undo->opening_value = opening_value;
+    undo->endgame_value = endgame_value;
+    undo->hash_value = hash_value;
+
+    if (lastMoveDoublePawnPush) {
+        hash_value ^= zobristKeys[772 + dPPFile];
+        lastMoveDoublePawnPush = false;
+    }
+    halfMoveClock++;
+    if (sideToMove == black) fullMoveClock++;
+    sideToMove = flipColour(sideToMove);
+    hash_value ^= zobristKeys[780];
+}
+
+void Board::unmakeNullMove(const undo_t& undo) {
+    sideToMove = flipColour(sideToMove);
+    lastMoveDoublePawnPush = undo.ep;
+    dPPFile = undo.dpp;
+    halfMoveClock = undo.halfMoveClock;
+    fullMoveClock = undo.fullMoveClock;
+    hash_value = undo.hash_value;
+}
+
 
 void Player::doMoveInPlace(move_t move) {
     std::string san = SAN_pre_move(move);
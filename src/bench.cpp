@@ -0,0 +1,376 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "bench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "magic.h"
+#include "move.h"
+#include "search.h"
+#include "table.h"
+#include "timeman.h"
+
+
+namespace chessCore {
+
+namespace {
+/**
+ *  The benchmark positions: openings, middlegames and endgames, with
+ *  castling, en passant, promotions and checks among them. Changing them
+ *  changes the benchmark's signature.
+ */
+const char* const bench_positions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+    "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+    "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+    "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+    "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/8 b - - 0 1",
+    "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+    "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+    "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+    "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+    "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+    "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+    "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+    "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+    "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+    "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+    "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+    "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+    "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+    "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 3 90",
+    "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+    "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+    "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+    "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+    "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+    "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+    "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1"
+};
+
+/** The number of random occupancies the slider lookups are timed on. */
+constexpr int SLIDER_BENCH_OCCUPANCIES = 4096;
+
+/**
+ *  Time rook and bishop lookups over a set of occupancies.
+ *
+ *  \param occupancies  The occupancies to look up.
+ *  \param rounds       The number of passes over the occupancies.
+ *  \param rook         The rook lookup, called as rook(sq, occupancy).
+ *  \param bishop       The bishop lookup, called as bishop(sq, occupancy).
+ *  \return             The mean time per lookup, in nanoseconds.
+ */
+template <typename Rook, typename Bishop>
+double time_slider_lookups(const std::vector<bitboard>& occupancies,
+                           int rounds, Rook rook, Bishop bishop) {
+    bitboard sink = 0;
+    search_clock::time_point start = search_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < occupancies.size(); i++) {
+            sink ^= rook(i & 63, occupancies[i]) ^
+                    bishop((i * 7) & 63, occupancies[i]);
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(
+        search_clock::now() - start).count();
+    // keep the lookups from being optimised away
+    volatile bitboard keep = sink;
+    (void)keep;
+    return ns / (2.0 * rounds * occupancies.size());
+}
+
+/**
+ *  \struct legacy_record_t
+ *
+ *  \brief The transposition table record before records were packed, with
+ *  the full hash and a field for everything. The baseline for
+ *  \ref bench_table.
+ */
+struct legacy_record_t {
+    uint64_t signature;
+    move_t best_move;
+    uint8_t depth;
+    uint8_t used;
+    value_t score;
+    uint8_t age;
+    valueType flag;
+};
+
+static_assert(sizeof(legacy_record_t) == 16,
+              "a legacy record should take 16 bytes");
+
+/** The number of legacy records in a 64-byte bucket. */
+constexpr int LEGACY_BUCKET_SIZE = 64 / sizeof(legacy_record_t);
+
+/**
+ *  \class LegacyTable
+ *  \brief A table of \ref legacy_record_t with the same buckets and
+ *  replacement scheme as \ref TransTable had, keeping just what the
+ *  benchmark needs.
+ */
+class LegacyTable {
+ private:
+    /** The records, LEGACY_BUCKET_SIZE to a bucket. */
+    std::vector<legacy_record_t> records;
+
+    /** The number of buckets. Always a power of two. */
+    size_t num_buckets;
+
+    /** \return The first record of the bucket for a given hash. */
+    legacy_record_t* bucket(uint64_t hash) {
+        return &records[(hash & (num_buckets - 1)) * LEGACY_BUCKET_SIZE];
+    }
+
+ public:
+    explicit LegacyTable(size_t mb) : records((mb << 20) /
+                                              sizeof(legacy_record_t)),
+                                      num_buckets(records.size() /
+                                                  LEGACY_BUCKET_SIZE) {}
+
+    size_t capacity() const { return records.size(); }
+
+    bool probe(uint64_t hash, int* depth) {
+        legacy_record_t* b = bucket(hash);
+        for (int i = 0; i < LEGACY_BUCKET_SIZE; i++) {
+            if (b[i].used && b[i].signature == hash) {
+                *depth = b[i].depth;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void save(uint64_t hash, int depth) {
+        legacy_record_t* b = bucket(hash);
+        legacy_record_t* replace = nullptr;
+        for (int i = 0; i < LEGACY_BUCKET_SIZE; i++) {
+            if (b[i].used && b[i].signature == hash) {
+                replace = b + i;
+                break;
+            }
+        }
+        if (!replace) {
+            // the shallowest depth-preferred slot, or else the last slot
+            for (int i = 0; i < LEGACY_BUCKET_SIZE - 1; i++) {
+                if (!b[i].used) {
+                    replace = b + i;
+                    break;
+                }
+                if (!replace || b[i].depth < replace->depth) replace = b + i;
+            }
+            if (replace->used && depth < replace->depth) {
+                replace = b + LEGACY_BUCKET_SIZE - 1;
+            }
+        }
+        *replace = legacy_record_t{hash, 0, static_cast<uint8_t>(depth), 1,
+                                   0, 0, EXACT};
+    }
+};
+
+/** Adapts \ref TransTable to the interface of \ref LegacyTable. */
+class PackedTable {
+ private:
+    TransTable table;
+
+ public:
+    explicit PackedTable(size_t mb) : table(mb) {}
+
+    size_t capacity() const { return table.capacity(); }
+
+    bool probe(uint64_t hash, int* depth) {
+        record_t rec;
+        if (!table.probe(hash, &rec)) return false;
+        *depth = rec.depth;
+        return true;
+    }
+
+    void save(uint64_t hash, int depth) {
+        table.save(hash, 0, 0, 0, static_cast<uint8_t>(depth), EXACT);
+    }
+};
+
+/** The counts from a table-pruned tree walk. */
+struct walk_stats_t {
+    uint64_t nodes = 0;
+    uint64_t probes = 0;
+    uint64_t hits = 0;
+};
+
+/**
+ *  Walk the legal move tree to a fixed depth, skipping any node the table
+ *  already has at least as deep.
+ *
+ *  \param b            The board to walk from. Restored afterwards.
+ *  \param depth        The depth left to walk.
+ *  \param table        The table to prune with.
+ *  \param stats        The counts to add to.
+ */
+template <typename Table>
+void table_walk(Board* b, int depth, Table* table, walk_stats_t* stats) {
+    stats->nodes++;
+    if (depth == 0) return;
+    uint64_t hash;
+    b->getHash(&hash);
+    stats->probes++;
+    int stored_depth;
+    if (table->probe(hash, &stored_depth) && stored_depth >= depth) {
+        stats->hits++;
+        return;
+    }
+    MoveList moves = b->gen_legal_moves();
+    for (move_t move : moves) {
+        undo_t undo;
+        b->makeMove(move, &undo);
+        table_walk(b, depth - 1, table, stats);
+        b->unmakeMove(move, undo);
+    }
+    table->save(hash, depth);
+}
+
+/**
+ *  Run the table benchmark's walks on one table, and report them.
+ *
+ *  \param name         The name of the record format.
+ *  \param mb           The size of the table, in megabytes.
+ *  \param out          The stream to write the report to.
+ */
+template <typename Table>
+void report_table_walk(const char* name, size_t mb, std::ostream& out) {
+    const struct {
+        const char* fen;
+        int depth;
+    } walks[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 5},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -"
+         " 0 1", 4},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6},
+    };
+
+    Table table(mb);
+    walk_stats_t stats;
+    for (const auto& walk : walks) {
+        Board b(walk.fen);
+        table_walk(&b, walk.depth, &table, &stats);
+    }
+    out << name << std::setw(10) << table.capacity() / mb << std::setw(10)
+        << 100.0 * stats.hits / stats.probes << "%" << std::setw(12)
+        << stats.nodes << std::endl;
+}
+}   // namespace
+
+
+uint64_t bench(int depth, std::ostream& out) {
+    TransTable table;
+    Searcher searcher(&table);
+    search_limits_t limits;
+    limits.depth = std::max(depth, 1);
+
+    int num_positions = sizeof(bench_positions) / sizeof(bench_positions[0]);
+    uint64_t total_nodes = 0;
+    search_clock::duration total_time = search_clock::duration::zero();
+    for (int i = 0; i < num_positions; i++) {
+        Board b(bench_positions[i]);
+        // each position starts a new game, so that it can't affect the next
+        searcher.new_game();
+        search_clock::time_point start = search_clock::now();
+        move_t best_move = searcher.search(&b, limits);
+        total_time += search_clock::now() - start;
+        uint64_t nodes = searcher.get_stats().nodes;
+        total_nodes += nodes;
+        out << "Position " << i + 1 << "/" << num_positions << ": "
+            << bench_positions[i] << std::endl
+            << "Best move " << mtos(best_move) << ", "
+            << nodes << " nodes" << std::endl;
+    }
+
+    int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+        total_time).count();
+    out << std::endl
+        << "Total time (ms) : " << us / 1000 << std::endl
+        << "Nodes searched  : " << total_nodes << std::endl;
+    // too short a time to measure gives no rate at all
+    if (us) {
+        out << "Nodes/second    : " << total_nodes * 1000000 / us << std::endl;
+    }
+    return total_nodes;
+}
+
+void bench_sliders(std::ostream& out) {
+    sliderBackend selected = slider_backend;
+    std::mt19937_64 rng(BENCH_SEED);
+    std::vector<bitboard> occupancies(SLIDER_BENCH_OCCUPANCIES);
+    for (bitboard& occupancy : occupancies) occupancy = rng() & rng();
+
+    auto rook_table = [](int sq, bitboard occupancy) {
+        return rookAttacks(sq, occupancy);
+    };
+    auto bishop_table = [](int sq, bitboard occupancy) {
+        return bishopAttacks(sq, occupancy);
+    };
+
+    out << "Slider attack lookups, " << SLIDER_BENCH_OCCUPANCIES
+        << " random occupancies:" << std::endl << std::fixed
+        << std::setprecision(2);
+    out << "Ray walker      : "
+        << time_slider_lookups(occupancies, 100, rookPushNaive,
+                               bishopPushNaive)
+        << " ns/lookup" << std::endl;
+    init_magics(magicBackend);
+    out << "Magic backend   : "
+        << time_slider_lookups(occupancies, 2000, rook_table, bishop_table)
+        << " ns/lookup" << std::endl;
+    if (cpu_has_fast_pext()) {
+        init_magics(pextBackend);
+        out << "PEXT backend    : "
+            << time_slider_lookups(occupancies, 2000, rook_table,
+                                   bishop_table)
+            << " ns/lookup" << std::endl;
+    } else {
+        out << "PEXT backend    : not supported" << std::endl;
+    }
+    init_magics(selected);
+    out << "Selected        : "
+        << (slider_backend == pextBackend ? "PEXT" : "magic") << std::endl;
+    out.unsetf(std::ios::floatfield);
+}
+
+void bench_table(size_t mb, std::ostream& out) {
+    mb = std::max<size_t>(mb, 1);
+    out << "Transposition table at " << mb << " MB:" << std::endl
+        << "format     records/MB  hit rate       nodes" << std::endl
+        << std::fixed << std::setprecision(1);
+    report_table_walk<LegacyTable>("16-byte  ", mb, out);
+    report_table_walk<PackedTable>("10-byte  ", mb, out);
+    out.unsetf(std::ios::floatfield);
+}
+
+}   // namespace chessCore
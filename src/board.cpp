@@ -456,6 +456,22 @@ int Board::num_pieces_left(colourPiece cp) const {
     return count_bits_set(pieceBoards[cp]);
 }
 
+int Board::piece_at(int square) const {
+    bitboard bb = 1ULL << square;
+    for (int i = 0; i < 12; i++) {
+        if (pieceBoards[i] & bb) return i;
+    }
+    return -1;
+}
+
+bool Board::has_non_pawn_material(colour side) const {
+    bitboard pieces = pieceBoards[6 * side + rook] |
+                      pieceBoards[6 * side + knight] |
+                      pieceBoards[6 * side + bishop] |
+                      pieceBoards[6 * side + queen];
+    return pieces != 0;
+}
+
 int Board::num_pieces_left() const {
     int ret = 0;
     for (int i = 0; i < 12; i++) {
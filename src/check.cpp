@@ -6,6 +6,7 @@ This source code is licensed under the BSD-style license found in the
 LICENSE file in the root directory of this source tree.
 */
 #include "board.h"
+#include "magic.h"
 #include "move.h"
 #include "twiddle.h"
 #include "typedefs.h"
@@ -108,6 +109,65 @@ bool Board::is_check(colour side, piece * checkingPiece, int * checkingInd,
     return ( count > 0);
 }
 
+bool Board::gives_check(move_t move) const {
+    int from_ind = from_sq(move);
+    int to_ind = to_sq(move);
+    bitboard from_square = (1ULL << from_ind);
+    colour otherSide = flipColour(sideToMove);
+    bitboard kingBoard = pieceBoards[(6 * otherSide) + 5];
+    int king_ind = last_set_bit(kingBoard);
+
+    int movingPiece = 0;
+    while (!(pieceBoards[(6 * sideToMove) + movingPiece] & from_square)) {
+        movingPiece++;
+    }
+    if (is_promotion(move)) movingPiece = which_promotion(move);
+
+    // the occupancy after the move
+    bitboard blockers = (takenSquares() & ~from_square) | (1ULL << to_ind);
+    if (is_ep_capture(move)) {
+        blockers &= ~(1ULL << (to_ind + ((sideToMove == white) ? S : N)));
+    }
+
+    // direct check
+    switch (movingPiece) {
+    case pawn:
+        if (pawnAttackNaive(to_ind, sideToMove) & kingBoard) return true;
+        break;
+    case knight:
+        if (knightPushNaive(to_ind) & kingBoard) return true;
+        break;
+    case rook:
+        if (rookAttacks(to_ind, blockers) & kingBoard) return true;
+        break;
+    case bishop:
+        if (bishopAttacks(to_ind, blockers) & kingBoard) return true;
+        break;
+    case queen:
+        if (queenAttacks(to_ind, blockers) & kingBoard) return true;
+        break;
+    default:
+        break;
+    }
+
+    // the castling rook
+    if (is_castle(move)) {
+        int rook_from = from_ind + (is_kingCastle(move) ? 3 : -4);
+        int rook_to = to_ind + (is_kingCastle(move) ? -1 : 1);
+        blockers = (blockers & ~(1ULL << rook_from)) | (1ULL << rook_to);
+        if (rookAttacks(rook_to, blockers) & kingBoard) return true;
+    }
+
+    // discovered check, including through an en-passant pawn; the moved
+    // piece is no longer a blocker, so it can't be found as the attacker
+    bitboard straight = (pieceBoards[(6 * sideToMove) + 1] |
+                         pieceBoards[(6 * sideToMove) + 4]) & blockers;
+    bitboard diagonal = (pieceBoards[(6 * sideToMove) + 3] |
+                         pieceBoards[(6 * sideToMove) + 4]) & blockers;
+    return (rookAttacks(king_ind, blockers) & straight) ||
+           (bishopAttacks(king_ind, blockers) & diagonal);
+}
+
 bool Board::is_checkmate() const {
     piece checkingPiece;
     int checkingInd;
@@ -11,7 +11,9 @@ LICENSE file in the root directory of this source tree.
 
 #include "board.h"
 #include "hash.h"
+#include "magic.h"
 #include "move.h"
+#include "search.h"
 
 
 namespace chessCore {
@@ -21,16 +23,28 @@ void init() {
     // initialise rays for sliding piece move generation
     init_rays();
 
+    // initialise magic attack tables, generated from the rays
+    init_magics();
+
     // initialise zobrist keys
     init_keys();
+
+    // initialise the late move reduction table
+    init_reductions();
 }
 
 void init(uint64_t seed) {
     // initialise rays for sliding piece move generation
     init_rays();
 
+    // initialise magic attack tables, generated from the rays
+    init_magics();
+
     // initialise zobrist keys
     init_keys(seed);
+
+    // initialise the late move reduction table
+    init_reductions();
 }
 
 
@@ -0,0 +1,234 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "magic.h"
+
+#if CHESSCORE_PEXT
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#include <cstring>
+
+#include "move.h"
+#include "twiddle.h"
+#include "typedefs.h"
+
+
+namespace chessCore {
+
+// magic multipliers, found by trial and error with a sparse random search
+// indexed by square
+
+namespace {
+
+constexpr bitboard rookMagicNumbers[64] = {
+    0x1080004008801020ULL, 0x0840092002c03000ULL,
+    0x1900200010400900ULL, 0x0880100008000480ULL,
+    0x4200100420080200ULL, 0x8100020100080400ULL,
+    0x0200040110886200ULL, 0x0200008040220411ULL,
+    0x0404800084400220ULL, 0x0000401000402000ULL,
+    0x0086001081220440ULL, 0x0408800800100280ULL,
+    0x000a001201040820ULL, 0x8848800200840080ULL,
+    0x4001000100040200ULL, 0x0442000102105084ULL,
+    0x9080010020804100ULL, 0x0040404000201009ULL,
+    0x0000808010002009ULL, 0x2200090021d00100ULL,
+    0x0008008008040080ULL, 0x0004004002010040ULL,
+    0x0011040008015042ULL, 0x00000a0001768104ULL,
+    0x0000800080204009ULL, 0x2010004140002001ULL,
+    0x9800200280100080ULL, 0x1000100080080080ULL,
+    0x0442000a00049020ULL, 0x2100040080020080ULL,
+    0x0800120400900148ULL, 0x0010040a00128541ULL,
+    0x2800804000800030ULL, 0x1010002000400041ULL,
+    0x4000200011004100ULL, 0x0610008410800800ULL,
+    0x0400802402800800ULL, 0xc100020080800400ULL,
+    0x0002000802000401ULL, 0x0182085882000401ULL,
+    0x0220204000808000ULL, 0x2860100040024022ULL,
+    0x0001002004110040ULL, 0x99101042000a0020ULL,
+    0x0004080004008080ULL, 0x0010040002008080ULL,
+    0x2012004881020004ULL, 0x8300842444820011ULL,
+    0x0088403882010200ULL, 0x0820400080210100ULL,
+    0x0110910040a00300ULL, 0x0801100280080480ULL,
+    0x0242009008200600ULL, 0x1002000489500200ULL,
+    0x0040800200010080ULL, 0x0091800041000080ULL,
+    0x0000209300488001ULL, 0x04c1002414824001ULL,
+    0x020020000b001041ULL, 0x7000100004200901ULL,
+    0x8002002004100802ULL, 0x30010002084c0007ULL,
+    0x0888221800813004ULL, 0x4000002840840112ULL
+};
+
+constexpr bitboard bishopMagicNumbers[64] = {
+    0xa010041108003100ULL, 0x006082020a002900ULL,
+    0x6810010619200000ULL, 0x08281a0520000408ULL,
+    0x0001104001000400ULL, 0x0018901008048400ULL,
+    0x00040a0210245280ULL, 0x000200210808a402ULL,
+    0x9140048410821200ULL, 0x0800091010820041ULL,
+    0x20504804832202c0ULL, 0x0100091401081000ULL,
+    0x8021011140000012ULL, 0x0810020804450400ULL,
+    0x208b0542109008a2ULL, 0x0080084a08040204ULL,
+    0x0040e2a80811244cULL, 0x2505022008008108ULL,
+    0x0430220100420040ULL, 0x010a040420220040ULL,
+    0x1105000290400000ULL, 0x0093001200822120ULL,
+    0x4000a62048043004ULL, 0x280120048a015004ULL,
+    0x006090002a020814ULL, 0x44042000240800d0ULL,
+    0x01102800040a4400ULL, 0x1004080080220040ULL,
+    0x0001001011004024ULL, 0x0010044000805040ULL,
+    0x0914041200820100ULL, 0x0004821012821480ULL,
+    0x0024040500c05021ULL, 0x0088611002080200ULL,
+    0x0116080a00040020ULL, 0x4000020080080080ULL,
+    0x2450450140840040ULL, 0x0000880201484100ULL,
+    0x0222020404020092ULL, 0x8081110600002e00ULL,
+    0x2842101105000801ULL, 0x1100809008001025ULL,
+    0x00020202221c0400ULL, 0x0422014022009020ULL,
+    0x0210046102100c00ULL, 0xc004008082029102ULL,
+    0x00aa461801101200ULL, 0x0404080080201108ULL,
+    0x020542108c205002ULL, 0x0410544804100100ULL,
+    0x0040910841100000ULL, 0x0400200042021100ULL,
+    0x00004204850400c0ULL, 0x0200100410a42102ULL,
+    0x1040020801210102ULL, 0x0805040410420000ULL,
+    0x2884804130100200ULL, 0x800c262201242000ULL,
+    0x1058000194108800ULL, 0x0014221054420204ULL,
+    0x0104000012a02200ULL, 0x0200881003300100ULL,
+    0x0140400202840100ULL, 0x0402020801010201ULL
+};
+
+// shared attack tables
+// every square gets a slice of 2^bits(mask) entries
+//-> rooks:   102400 * 64 bits = 800K
+//-> bishops:   5248 * 64 bits =  41K
+
+bitboard rookAttackTable[102400];
+bitboard bishopAttackTable[5248];
+
+#if CHESSCORE_PEXT
+__attribute__((target("bmi2")))
+uint64_t pext_index(bitboard blockers, bitboard mask) {
+    return _pext_u64(blockers, mask);
+}
+#endif
+
+bitboard rookMask(int sq) {
+    return (rays[dirN][sq] & notRankEight) | (rays[dirS][sq] & notRankOne) |
+           (rays[dirE][sq] & notFileH) | (rays[dirW][sq] & notFileA);
+}
+
+bitboard bishopMask(int sq) {
+    bitboard edges = rankOne | rankEight | fileA | fileH;
+    return (rays[dirNE][sq] | rays[dirSE][sq] |
+            rays[dirSW][sq] | rays[dirNW][sq]) & ~edges;
+}
+
+/**
+ *  Fill in the lookup parameters and the attack table for one type of
+ *  sliding piece.
+ *
+ *  \param magics       The array of lookup parameters to fill.
+ *  \param numbers      The magic multipliers, indexed by square.
+ *  \param table        The shared attack table to fill.
+ *  \param rook         Whether to generate rook or bishop attacks.
+ *
+ *  The table is laid out for \ref slider_backend, so it must already be set.
+ */
+void init_table(magic_t* magics, const bitboard* numbers,
+                bitboard* table, bool rook) {
+    bitboard* next = table;
+
+    for (int sq = 0; sq < 64; sq++) {
+        magic_t& m = magics[sq];
+        m.mask = rook ? rookMask(sq) : bishopMask(sq);
+        m.magic = numbers[sq];
+        m.shift = 64 - count_bits_set(m.mask);
+        m.attacks = next;
+
+        // enumerate all subsets of the mask (Carry-Rippler)
+        bitboard occ = 0ULL;
+        do {
+            bitboard attacks = rook ? rookPushNaive(sq, occ)
+                                    : bishopPushNaive(sq, occ);
+#if CHESSCORE_PEXT
+            if (slider_backend == pextBackend) {
+                m.attacks[pext_index(occ, m.mask)] = attacks;
+            } else {
+                m.attacks[(occ * m.magic) >> m.shift] = attacks;
+            }
+#else
+            m.attacks[(occ * m.magic) >> m.shift] = attacks;
+#endif
+            occ = (occ - m.mask) & m.mask;
+        } while (occ);
+
+        next += (1ULL << (64 - m.shift));
+    }
+}
+
+}   // namespace
+
+magic_t rookMagics[64];
+magic_t bishopMagics[64];
+sliderBackend slider_backend = magicBackend;
+
+#if CHESSCORE_PEXT
+__attribute__((target("bmi2")))
+bitboard rookAttacksPext(int sq, bitboard blockers) {
+    const magic_t& m = rookMagics[sq];
+    return m.attacks[_pext_u64(blockers, m.mask)];
+}
+
+__attribute__((target("bmi2")))
+bitboard bishopAttacksPext(int sq, bitboard blockers) {
+    const magic_t& m = bishopMagics[sq];
+    return m.attacks[_pext_u64(blockers, m.mask)];
+}
+
+bool cpu_has_fast_pext() {
+    unsigned int eax, ebx, ecx, edx;
+    char vendor[13];
+
+    // leaf 0: highest leaf and vendor string
+    if (!__get_cpuid(0, &eax, &ebx, &ecx, &edx) || eax < 7) return false;
+    std::memcpy(vendor, &ebx, 4);
+    std::memcpy(vendor + 4, &edx, 4);
+    std::memcpy(vendor + 8, &ecx, 4);
+    vendor[12] = '\0';
+
+    // leaf 7, subleaf 0: ebx bit 8 is BMI2
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (!(ebx & (1U << 8))) return false;
+
+    // AMD before Zen 3 (family 0x19) runs PEXT in microcode
+    if (std::strcmp(vendor, "AuthenticAMD") == 0) {
+        __cpuid(1, eax, ebx, ecx, edx);
+        unsigned int family = (eax >> 8) & 0xf;
+        if (family == 0xf) family += (eax >> 20) & 0xff;
+        if (family < 0x19) return false;
+    }
+
+    return true;
+}
+#else
+bool cpu_has_fast_pext() {
+    return false;
+}
+#endif
+
+void init_magics() {
+    // the PEXT lookups are out of line, and that costs more than PEXT saves
+    init_magics(magicBackend);
+}
+
+void init_magics(sliderBackend backend) {
+    if (backend == pextBackend && !cpu_has_fast_pext()) {
+        backend = magicBackend;
+    }
+    slider_backend = backend;
+
+    init_table(rookMagics, rookMagicNumbers, rookAttackTable, true);
+    init_table(bishopMagics, bishopMagicNumbers, bishopAttackTable, false);
+}
+
+
+}   // namespace chessCore
@@ -6,10 +6,12 @@ This source code is licensed under the BSD-style license found in the
 LICENSE file in the root directory of this source tree.
 */
 #include <cstdlib>
+#include <cstring>
 #include <limits>
 #include <string>
 
 #include "action.h"
+#include "bench.h"
 #include "board.h"
 #include "eval.h"
 #include "hash.h"
@@ -17,11 +19,34 @@ LICENSE file in the root directory of this source tree.
 #include "move.h"
 #include "play.h"
 #include "search.h"
+#include "selftest.h"
 #include "twiddle.h"
+#include "uci.h"
 
 
-int main() {
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "bench") == 0) {
+        // fixed hash keys, so that the node count is reproducible
+        chessCore::init(chessCore::BENCH_SEED);
+        if (argc > 2 && std::strcmp(argv[2], "sliders") == 0) {
+            chessCore::bench_sliders();
+        } else if (argc > 2 && std::strcmp(argv[2], "table") == 0) {
+            chessCore::bench_table(argc > 3 ? std::atoi(argv[3]) :
+                                              chessCore::TABLE_BENCH_MB);
+        } else {
+            chessCore::bench(argc > 2 ? std::atoi(argv[2]) :
+                                        chessCore::BENCH_DEPTH);
+        }
+        return 0;
+    }
     chessCore::init();
+    if (argc > 1 && std::strcmp(argv[1], "test") == 0) {
+        return chessCore::run_selftests() ? 1 : 0;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "uci") == 0) {
+        chessCore::uci_loop();
+        return 0;
+    }
     std::string str = "1k1r4/pp1b1R2/3q2pp/4p3/2B5/4Q3/PPP2B2/2K5 b - -";
     chessCore::Player* player = new chessCore::Player(str);
     player->play();
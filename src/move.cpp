@@ -9,6 +9,7 @@ LICENSE file in the root directory of this source tree.
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <iostream>
 #include <string>
@@ -16,6 +17,8 @@ LICENSE file in the root directory of this source tree.
 
 #include "action.h"
 #include "board.h"
+#include "eval.h"
+#include "magic.h"
 #include "twiddle.h"
 #include "typedefs.h"
 
@@ -525,7 +528,7 @@ bool is_castle(move_t move) {
 
 
 
-move_t stom(MoveList moves, std::string s) {
+move_t stom(const MoveList& moves, std::string s) {
     std::string from = s.substr(0, 2);
     std::string to = s.substr(2, 2);
     int from_ind = _stoi(from);
@@ -666,6 +669,9 @@ bitboard kingTargets(int sq, bitboard _white, bitboard _black,
 }
 
 // sliding piece generation
+// the ray-walking functions are only used to fill the magic attack
+// tables at startup (see magic.h), the targets use the table lookups
+
 // bishops
 
 bitboard bishopPushNaive(int sq, bitboard blockers) {
@@ -705,7 +711,7 @@ bitboard bishopPushNaive(int sq, bitboard blockers) {
 
 bitboard bishopTargets(int sq, bitboard _white, bitboard _black,
                        colour movingColour) {
-    bitboard moves = bishopPushNaive(sq, _white | _black);
+    bitboard moves = bishopAttacks(sq, _white | _black);
     if (movingColour == white) {
         return (moves & (~_white));
     } else {
@@ -752,7 +758,7 @@ bitboard rookPushNaive(int sq, bitboard blockers) {
 
 bitboard rookTargets(int sq, bitboard _white, bitboard _black,
                      colour movingColour) {
-    bitboard moves = rookPushNaive(sq, _white | _black);
+    bitboard moves = rookAttacks(sq, _white | _black);
     if (movingColour == white) {
         return (moves & (~_white));
     } else {
@@ -768,7 +774,7 @@ bitboard queenPushNaive(int sq, bitboard blockers) {
 
 bitboard queenTargets(int sq, bitboard _white, bitboard _black,
                       colour movingColour) {
-    bitboard moves = queenPushNaive(sq, _white | _black);
+    bitboard moves = queenAttacks(sq, _white | _black);
     if (movingColour == white) {
         return (moves & (~_white));
     } else {
@@ -827,7 +833,7 @@ bitboard allTargets(colour side, bitboard* pieces) {
     // rooks
     tmp = pieces[(side * 6) + 1];
     ITER_BITBOARD(sq, tmp) {
-        attacked |= rookPushNaive(sq, allPieces);
+        attacked |= rookAttacks(sq, allPieces);
     }
 
     // knights
@@ -839,13 +845,13 @@ bitboard allTargets(colour side, bitboard* pieces) {
     // bishops
     tmp = pieces[(side * 6) + 3];
     ITER_BITBOARD(sq, tmp) {
-        attacked |= bishopPushNaive(sq, allPieces);
+        attacked |= bishopAttacks(sq, allPieces);
     }
 
     // queens
     tmp = pieces[(side * 6) + 4];
     ITER_BITBOARD(sq, tmp) {
-        attacked |= queenPushNaive(sq, allPieces);
+        attacked |= queenAttacks(sq, allPieces);
     }
 
     // kings
@@ -877,6 +883,23 @@ void Board::add_moves(MoveList* dest, move_t move, bool check_legal) const {
 
 MoveList Board::gen_moves() const {
     MoveList moves;
+    gen_pseudo_moves(&moves, true, true);
+    return moves;
+}
+
+MoveList Board::gen_tactical_moves() const {
+    MoveList moves;
+    gen_pseudo_moves(&moves, true, false);
+    return moves;
+}
+
+MoveList Board::gen_quiet_moves() const {
+    MoveList moves;
+    gen_pseudo_moves(&moves, false, true);
+    return moves;
+}
+
+void Board::gen_pseudo_moves(MoveList* moves, bool tactical, bool quiet) const {
     int piece;
     int from_sq;
     int to_sq;
@@ -889,29 +912,31 @@ MoveList Board::gen_moves() const {
             if (pieceBoards[piece] & (1ULL << from_sq)) {
                 targets = pieceTargets(from_sq, _white,
                                        _black, colourPiece(piece));
+                if (!quiet) targets &= (_white | _black | rankOne | rankEight);
 
                 ITER_BITBOARD(to_sq, targets) {
                     // found a move!
                     if (((1ULL << to_sq) & _black) |
                         ((1ULL << to_sq) & _white)) {
                         // capture
+                        if (!tactical) continue;
                         if ((piece % 6 == 0) &&
                             ((rankOne | rankEight)&(1ULL << to_sq))) {
                             // promotion
-                            add_moves(&moves,
+                            add_moves(moves,
                                       make_move(from_sq, to_sq, 1, 1, 0, 0),
                                       false);
-                            add_moves(&moves,
+                            add_moves(moves,
                                       make_move(from_sq, to_sq, 1, 1, 0, 1),
                                       false);
-                            add_moves(&moves,
+                            add_moves(moves,
                                       make_move(from_sq, to_sq, 1, 1, 1, 0),
                                       false);
-                            add_moves(&moves,
+                            add_moves(moves,
                                       make_move(from_sq, to_sq, 1, 1, 1, 1),
                                       false);
                         } else {
-                            add_moves(&moves,
+                            add_moves(moves,
                                       make_move(from_sq, to_sq, 0, 1, 0, 0),
                                       false);
                         }
@@ -919,35 +944,35 @@ MoveList Board::gen_moves() const {
                         // non-capture
                         if ((piece % 6 == 0) & (abs(from_sq - to_sq) == 16)) {
                             // double pawn push
+                            if (!quiet) continue;
                             if (!((1ULL << ((from_sq + to_sq) / 2)) &
                                   (_black | _white))) {
-                                add_moves(&moves,
-                                      make_move(from_sq, to_sq, 0, 0, 0, 1),
-                                      false);
-                            } else {
+                                add_moves(moves,
+                                          make_move(from_sq, to_sq, 0, 0, 0, 1),
+                                          false);
                             }
+                        } else if ((piece % 6 == 0) &&
+                                   ((rankOne | rankEight)&(1ULL << to_sq))) {
+                            // promotion, counted as tactical
+                            if (!tactical) continue;
+                            add_moves(moves,
+                                      make_move(from_sq, to_sq, 1, 0, 0, 0),
+                                      false);
+                            add_moves(moves,
+                                      make_move(from_sq, to_sq, 1, 0, 0, 1),
+                                      false);
+                            add_moves(moves,
+                                      make_move(from_sq, to_sq, 1, 0, 1, 0),
+                                      false);
+                            add_moves(moves,
+                                      make_move(from_sq, to_sq, 1, 0, 1, 1),
+                                      false);
                         } else {
                             // quiet move
-                            if ((piece % 6 == 0) &&
-                                 ((rankOne | rankEight)&(1ULL << to_sq))) {
-                                // promotion
-                                add_moves(&moves,
-                                          make_move(from_sq, to_sq, 1, 0, 0, 0),
-                                          false);
-                                add_moves(&moves,
-                                          make_move(from_sq, to_sq, 1, 0, 0, 1),
-                                          false);
-                                add_moves(&moves,
-                                          make_move(from_sq, to_sq, 1, 0, 1, 0),
-                                          false);
-                                add_moves(&moves,
-                                          make_move(from_sq, to_sq, 1, 0, 1, 1),
-                                          false);
-                            } else {
-                                add_moves(&moves,
-                                          make_move(from_sq, to_sq, 0, 0, 0, 0),
-                                          false);
-                            }
+                            if (!quiet) continue;
+                            add_moves(moves,
+                                      make_move(from_sq, to_sq, 0, 0, 0, 0),
+                                      false);
                         }
                     }
                 }
@@ -957,7 +982,7 @@ MoveList Board::gen_moves() const {
     // fringe cases
 
     // ep capture
-    if (lastMoveDoublePawnPush) {
+    if (tactical && lastMoveDoublePawnPush) {
         // if white to move: potential squares are (32 + dPPFile +-1)
         // if black to move: potential squares are (24 + dPPFile +-1)
         int oppPawnSquare = 32 - (8 * sideToMove) + dPPFile;
@@ -967,17 +992,25 @@ MoveList Board::gen_moves() const {
         int captureSquare = 40 - (24 * sideToMove) + dPPFile;
         if (left & (pieceBoards[ 6 * sideToMove ])) {
             int leftSquare = last_set_bit(left);
-            add_moves(&moves, make_move(leftSquare, captureSquare, 0, 1, 0, 1),
-                               false);
+            add_moves(moves,
+                      make_move(leftSquare, captureSquare, 0, 1, 0, 1),
+                      false);
         }
         if (right & (pieceBoards[ 6 * sideToMove ])) {
             int rightSquare = last_set_bit(right);
-            add_moves(&moves, make_move(rightSquare, captureSquare, 0, 1, 0, 1),
-                               false);
+            add_moves(moves,
+                      make_move(rightSquare, captureSquare, 0, 1, 0, 1),
+                      false);
         }
     }
 
     // castling
+    if (!quiet) return;
+    bool castleKingSide = (sideToMove == white) ? castleWhiteKingSide :
+                                                  castleBlackKingSide;
+    bool castleQueenSide = (sideToMove == white) ? castleWhiteQueenSide :
+                                                   castleBlackQueenSide;
+    if (!castleKingSide && !castleQueenSide) return;
     bitboard pb[12];
     getBitboards(pb);
     bitboard attacked_squares = allTargets(flipColour(sideToMove), pb);
@@ -986,31 +1019,142 @@ MoveList Board::gen_moves() const {
             (!((_white | _black) & 0x0000000000000060))) {
             // can't castle through check
             if (!(attacked_squares & 0x0000000000000060)) {
-                add_moves(&moves, make_move(4, 6, 0, 0, 1, 0), false);
+                add_moves(moves, make_move(4, 6, 0, 0, 1, 0), false);
             }
         }
         if (castleWhiteQueenSide &&
             (!((_white | _black) & 0x000000000000000e))) {
             if (!(attacked_squares & 0x000000000000000c)) {
-                add_moves(&moves, make_move(4, 2, 0, 0, 1, 1), false);
+                add_moves(moves, make_move(4, 2, 0, 0, 1, 1), false);
             }
         }
     } else if (sideToMove == black && !is_check(black)) {
         if (castleBlackKingSide &&
             (!((_white | _black) & 0x6000000000000000))) {
             if (!(attacked_squares & 0x6000000000000000)) {
-                add_moves(&moves, make_move(60, 62, 0, 0, 1, 0), false);
+                add_moves(moves, make_move(60, 62, 0, 0, 1, 0), false);
             }
         }
         if (castleBlackQueenSide &&
             (!((_white | _black) & 0x0e00000000000000))) {
             if (!(attacked_squares & 0x0c00000000000000)) {
-                add_moves(&moves, make_move(60, 58, 0, 0, 1, 1), false);
+                add_moves(moves, make_move(60, 58, 0, 0, 1, 1), false);
             }
         }
     }
+}
 
-    return moves;
+bool Board::is_pseudo_legal(move_t move) const {
+    int from = from_sq(move);
+    int to = to_sq(move);
+    int moving = piece_at(from);
+    if (moving == -1 || moving / 6 != sideToMove) return false;
+
+    if (is_castle(move) || is_ep_capture(move)) {
+        // rare enough to check against the generated moves
+        MoveList moves;
+        gen_pseudo_moves(&moves, is_ep_capture(move), is_castle(move));
+        for (move_t m : moves) {
+            if (m == move) return true;
+        }
+        return false;
+    }
+
+    bitboard _white = whiteSquares();
+    bitboard _black = blackSquares();
+    bitboard to_square = (1ULL << to);
+    bitboard targets = pieceTargets(from, _white, _black, colourPiece(moving));
+    if (!(targets & to_square)) return false;
+
+    bool capture = (_white | _black) & to_square;
+    bool is_pawn = (moving % 6 == 0);
+    bool promotion = is_pawn && ((rankOne | rankEight) & to_square);
+    bool doublePP = is_pawn && (abs(from - to) == 16);
+    if (is_capture(move) != capture || is_promotion(move) != promotion) {
+        return false;
+    }
+    // any of the four promotion pieces will do
+    if (promotion) return true;
+    if (doublePP && ((1ULL << ((from + to) / 2)) & (_white | _black))) {
+        return false;
+    }
+    return move == make_move(from, to, 0, capture, 0, doublePP);
+}
+
+bitboard Board::attackers_to(int square, bitboard occupied) const {
+    bitboard rooks = pieceBoards[1] | pieceBoards[4] |
+                     pieceBoards[7] | pieceBoards[10];
+    bitboard bishops = pieceBoards[3] | pieceBoards[4] |
+                       pieceBoards[9] | pieceBoards[10];
+    bitboard attackers =
+        (pawnAttackNaive(square, black) & pieceBoards[0]) |
+        (pawnAttackNaive(square, white) & pieceBoards[6]) |
+        (knightPushNaive(square) & (pieceBoards[2] | pieceBoards[8])) |
+        (kingPushNaive(square) & (pieceBoards[5] | pieceBoards[11])) |
+        (rookAttacks(square, occupied) & rooks) |
+        (bishopAttacks(square, occupied) & bishops);
+    return attackers & occupied;
+}
+
+value_t Board::see(move_t move) const {
+    // the material gained after each capture in the exchange, from the
+    // point of view of the side making it
+    int gain[32];
+    int d = 0;
+    int from = from_sq(move);
+    int to = to_sq(move);
+    int attacker = piece_at(from) % 6;
+    bitboard occupied = takenSquares();
+    bitboard rooks = pieceBoards[1] | pieceBoards[4] |
+                     pieceBoards[7] | pieceBoards[10];
+    bitboard bishops = pieceBoards[3] | pieceBoards[4] |
+                       pieceBoards[9] | pieceBoards[10];
+
+    if (is_ep_capture(move)) {
+        gain[0] = pieceValues[0][pawn];
+        occupied ^= 1ULL << (to + ((sideToMove == white) ? S : N));
+    } else if (is_capture(move)) {
+        gain[0] = pieceValues[0][piece_at(to) % 6];
+    } else {
+        gain[0] = 0;
+    }
+    if (is_promotion(move)) {
+        attacker = which_promotion(move);
+        gain[0] += pieceValues[0][attacker] - pieceValues[0][pawn];
+    }
+
+    bitboard from_set = 1ULL << from;
+    bitboard attackers = attackers_to(to, occupied);
+    colour side = sideToMove;
+    do {
+        d++;
+        side = flipColour(side);
+        // the piece on the square is captured next, if it's worth it
+        gain[d] = pieceValues[0][attacker] - gain[d - 1];
+        if (std::max(-gain[d - 1], gain[d]) < 0) break;
+
+        // moving a piece can uncover a slider behind it
+        occupied ^= from_set;
+        attackers = (attackers |
+                     (rookAttacks(to, occupied) & rooks) |
+                     (bishopAttacks(to, occupied) & bishops)) & occupied;
+
+        // the least valuable attacker of the side to capture goes next
+        from_set = 0;
+        for (int p : {pawn, knight, bishop, rook, queen, king}) {
+            bitboard candidates = attackers & pieceBoards[6 * side + p];
+            if (candidates) {
+                from_set = candidates & -candidates;
+                attacker = p;
+                break;
+            }
+        }
+    } while (from_set && d < 31);
+
+    while (--d) {
+        gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+    }
+    return static_cast<value_t>(gain[0]);
 }
 
 MoveList Board::get_out_of_check(colour side, piece checkingPiece,
@@ -1604,6 +1748,7 @@ bool Board::is_legal(move_t move) const {
 
     for (int i = 0; i < 8; i++) {
         _ray2 = rays[i][from_ind] & blockers;
+        if (!_ray2) continue;
         if ((i + 1) % 8 < 4) {
             _ray2 = (1ULL << first_set_bit(_ray2));
         } else {
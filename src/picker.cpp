@@ -0,0 +1,314 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "picker.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "board.h"
+#include "eval.h"
+#include "move.h"
+#include "typedefs.h"
+
+
+namespace chessCore {
+
+namespace {
+
+/**
+ *  The lowest score of a capture or promotion. Quiet moves score below it,
+ *  so that they come last in a list of evasions.
+ */
+constexpr int SCORE_CAPTURE = 1 << 20;
+
+/**
+ *  The offset of the scores of captures that lose material, which puts
+ *  them below every quiet move.
+ */
+constexpr int SCORE_BAD_CAPTURE = -2 * SCORE_CAPTURE;
+
+/**
+ *  Piece values for MVV-LVA ordering, indexed by \ref piece.
+ *  The king is never captured, and is the least valuable attacker.
+ */
+constexpr int mvv_lva_value[6] = {1, 5, 3, 3, 9, 0};
+
+/**
+ *  Score a capture or promotion by MVV-LVA: the most valuable victim
+ *  first, then the least valuable attacker.
+ *
+ *  \param b            The board the move is made from.
+ *  \param move         The capture or promotion to score.
+ *  \return             The score, at least SCORE_CAPTURE.
+ */
+int score_capture(const Board* b, move_t move) {
+    int from = from_sq(move);
+    int to = to_sq(move);
+    int victim = is_ep_capture(move) ? pawn :
+                 is_capture(move) ? b->piece_at(to) % 6 : -1;
+    int attacker = b->piece_at(from) % 6;
+    int score = SCORE_CAPTURE;
+    if (victim != -1) score += 64 * mvv_lva_value[victim];
+    if (is_promotion(move)) score += 64 * mvv_lva_value[which_promotion(move)];
+    return score + 8 - mvv_lva_value[attacker];
+}
+
+/**
+ *  Score a quiet move by its history score, and then by how much it
+ *  improves the moving piece's piece-square value.
+ *
+ *  \param b            The board the move is made from.
+ *  \param move         The quiet move to score.
+ *  \param phase        The phase of the game, see \ref Board::getPhase.
+ *  \param sign         1 if white is to move, -1 if black is.
+ *  \param history      The history scores for the side to move, or nullptr.
+ *  \return             The score, less than SCORE_CAPTURE.
+ */
+int score_quiet(const Board* b, move_t move, int phase, int sign,
+                const int (*history)[64]) {
+    int from = from_sq(move);
+    int to = to_sq(move);
+    int p = b->piece_at(from);
+    int opening = pieceSquareTables[0][p][to] - pieceSquareTables[0][p][from];
+    int endgame = pieceSquareTables[1][p][to] - pieceSquareTables[1][p][from];
+    int score = sign * (opening * (256 - phase) + endgame * phase) / 256;
+    if (history) score += history[from][to];
+    return score;
+}
+
+/**
+ *  Move a history score towards a bonus. The score changes less the
+ *  closer it already is to the bonus's sign, so it stays within
+ *  +/- MAX_HISTORY.
+ *
+ *  \param score        The history score to update.
+ *  \param bonus        The bonus, or a penalty if negative.
+ */
+void update_history(int* score, int bonus) {
+    *score += bonus - *score * std::abs(bonus) / MAX_HISTORY;
+}
+
+}   // namespace
+
+
+void heuristics_t::clear() {
+    std::memset(killers, 0, sizeof(killers));
+    std::memset(history, 0, sizeof(history));
+    std::memset(counter_moves, 0, sizeof(counter_moves));
+}
+
+void heuristics_t::new_search() {
+    std::memset(killers, 0, sizeof(killers));
+    for (int side = 0; side < 2; side++) {
+        for (int from = 0; from < 64; from++) {
+            for (int to = 0; to < 64; to++) {
+                history[side][from][to] /= 2;
+            }
+        }
+    }
+}
+
+void heuristics_t::update(colour side, int ply, int depth, move_t move,
+                          move_t prev_move, const move_t* tried,
+                          int num_tried) {
+    if (ply < MAX_PLY && killers[ply][0] != move) {
+        for (int i = NUM_KILLERS - 1; i > 0; i--) {
+            killers[ply][i] = killers[ply][i - 1];
+        }
+        killers[ply][0] = move;
+    }
+
+    int bonus = std::min(depth * depth, 400);
+    update_history(&history[side][from_sq(move)][to_sq(move)], bonus);
+    for (int i = 0; i < num_tried; i++) {
+        update_history(&history[side][from_sq(tried[i])][to_sq(tried[i])],
+                       -bonus);
+    }
+
+    if (prev_move) {
+        counter_moves[from_sq(prev_move)][to_sq(prev_move)] = move;
+    }
+}
+
+
+MovePicker::MovePicker(const Board* b, move_t first_move, move_t tt_move,
+                       const heuristics_t* heur, int ply,
+                       move_t prev_move) :
+        board(b), stage(firstMoveStage), first_move(first_move),
+        tt_move(tt_move), tactical_only(false), history(nullptr),
+        num_refutations(0), index(0) {
+    if (this->tt_move == this->first_move) this->tt_move = 0;
+    if (!heur) return;
+
+    colour side;
+    board->getSide(&side);
+    history = heur->history[side];
+
+    move_t candidates[NUM_KILLERS + 1];
+    int num_candidates = 0;
+    if (ply < MAX_PLY) {
+        for (int i = 0; i < NUM_KILLERS; i++) {
+            candidates[num_candidates++] = heur->killers[ply][i];
+        }
+    }
+    if (prev_move) {
+        candidates[num_candidates++] =
+            heur->counter_moves[from_sq(prev_move)][to_sq(prev_move)];
+    }
+    for (int i = 0; i < num_candidates; i++) {
+        move_t move = candidates[i];
+        // captures and promotions have been tried by then
+        if (!move || is_capture(move) || is_promotion(move)) continue;
+        if (move == this->first_move || move == this->tt_move) continue;
+        if (std::find(refutations, refutations + num_refutations, move) !=
+            refutations + num_refutations) continue;
+        refutations[num_refutations++] = move;
+    }
+}
+
+MovePicker::MovePicker(const Board* b) :
+        board(b), stage(genTacticalStage), first_move(0), tt_move(0),
+        tactical_only(true), history(nullptr), num_refutations(0),
+        index(0) {}
+
+bool MovePicker::is_valid_hash_move(move_t move) const {
+    return move && board->is_pseudo_legal(move) && board->is_legal(move);
+}
+
+void MovePicker::score_moves() {
+    colour side;
+    board->getSide(&side);
+    int sign = (side == white) ? 1 : -1;
+    int phase = board->getPhase();
+    for (int i = 0; i < moves.size(); i++) {
+        move_t move = moves[i];
+        if (is_capture(move) || is_promotion(move)) {
+            scores[i] = score_capture(board, move);
+        } else {
+            scores[i] = score_quiet(board, move, phase, sign, history);
+        }
+    }
+}
+
+move_t MovePicker::select(bool legal_check, bool good_captures) {
+    while (index < moves.size()) {
+        // one step of a selection sort: most nodes cut off after a move
+        // or two, so this is cheaper than sorting the whole list
+        int best = index;
+        for (int j = index + 1; j < moves.size(); j++) {
+            if (scores[j] > scores[best]) best = j;
+        }
+        if (good_captures) {
+            // only the losing captures are left
+            if (scores[best] < SCORE_CAPTURE) return 0;
+            // SEE is only worth running on moves we're about to search
+            if (board->see(moves[best]) < 0) {
+                scores[best] += SCORE_BAD_CAPTURE;
+                continue;
+            }
+        }
+        std::swap(moves[index], moves[best]);
+        std::swap(scores[index], scores[best]);
+        move_t move = moves[index++];
+
+        if (move == first_move || move == tt_move) continue;
+        if (std::find(refutations, refutations + num_refutations, move) !=
+            refutations + num_refutations) continue;
+        if (legal_check && !board->is_legal(move)) continue;
+        return move;
+    }
+    return 0;
+}
+
+move_t MovePicker::next() {
+    move_t move;
+    switch (stage) {
+        case firstMoveStage:
+            stage = ttMoveStage;
+            if (is_valid_hash_move(first_move)) return first_move;
+            first_move = 0;
+            // fall through
+        case ttMoveStage:
+            stage = genTacticalStage;
+            if (is_valid_hash_move(tt_move)) return tt_move;
+            tt_move = 0;
+            // fall through
+        case genTacticalStage:
+            if (!tactical_only) {
+                colour side;
+                board->getSide(&side);
+                if (board->is_check(side)) {
+                    stage = genEvasionStage;
+                    return next();
+                }
+            }
+            moves = board->gen_tactical_moves();
+            score_moves();
+            index = 0;
+            stage = tacticalStage;
+            // fall through
+        case tacticalStage:
+            move = select(true, true);
+            if (move) return move;
+            if (tactical_only) {
+                // losing captures aren't worth searching in quiescence
+                stage = doneStage;
+                return 0;
+            }
+            // keep the losing captures, to try after the quiet moves
+            for (int i = index; i < moves.size(); i++) {
+                bad_captures.push_back(moves[i]);
+            }
+            index = 0;
+            stage = killerStage;
+            // fall through
+        case killerStage:
+            while (index < num_refutations) {
+                move = refutations[index++];
+                if (is_valid_hash_move(move)) return move;
+            }
+            stage = genQuietStage;
+            // fall through
+        case genQuietStage:
+            moves = board->gen_quiet_moves();
+            score_moves();
+            for (move_t bad_capture : bad_captures) {
+                scores[moves.size()] = score_capture(board, bad_capture) +
+                                       SCORE_BAD_CAPTURE;
+                moves.push_back(bad_capture);
+            }
+            index = 0;
+            stage = quietStage;
+            // fall through
+        case quietStage:
+            move = select(true, false);
+            if (move) return move;
+            stage = doneStage;
+            return 0;
+        case genEvasionStage:
+            // the refutations haven't been tried, so don't skip them
+            num_refutations = 0;
+            moves = board->gen_legal_moves();
+            score_moves();
+            index = 0;
+            stage = evasionStage;
+            // fall through
+        case evasionStage:
+            move = select(false, false);
+            if (move) return move;
+            stage = doneStage;
+            return 0;
+        case doneStage:
+        default:
+            return 0;
+    }
+}
+
+}   // namespace chessCore
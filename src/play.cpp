@@ -12,6 +12,7 @@ LICENSE file in the root directory of this source tree.
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 
 #include "action.h"
@@ -20,6 +21,8 @@ LICENSE file in the root directory of this source tree.
 #include "move.h"
 #include "parse.h"
 #include "search.h"
+#include "table.h"
+#include "timeman.h"
 #include "typedefs.h"
 
 
@@ -30,12 +33,16 @@ Player::Player() : Board::Board() {
     user_colour = white;
     iterative_deepening_timeout = 60;
     searcher = new Searcher(&trans_table);
+    ponder = true;
+    ponder_move = 0;
 }
 
 Player::Player(colour userColour) : Board::Board() {
     user_colour = userColour;
     iterative_deepening_timeout = 60;
     searcher = new Searcher(&trans_table);
+    ponder = true;
+    ponder_move = 0;
 }
 
 Player::Player(bitboard * startPositions, bool * castling, bool ep, int dpp,
@@ -46,6 +53,8 @@ Player::Player(bitboard * startPositions, bool * castling, bool ep, int dpp,
     user_colour = white;
     iterative_deepening_timeout = 60;
     searcher = new Searcher(&trans_table);
+    ponder = true;
+    ponder_move = 0;
 }
 
 Player::Player(const Player& p1) : Board::Board(p1) {
@@ -55,12 +64,16 @@ Player::Player(const Player& p1) : Board::Board(p1) {
     user_colour = white;
     iterative_deepening_timeout = 60;
     searcher = new Searcher(&trans_table);
+    ponder = true;
+    ponder_move = 0;
 }
 
 Player::Player(std::string fen) : Board::Board(fen) {
     user_colour = white;
     iterative_deepening_timeout = 60;
     searcher = new Searcher(&trans_table);
+    ponder = true;
+    ponder_move = 0;
 }
 
 void Player::setTimeout(int timeout) {
@@ -79,6 +92,29 @@ namespace {
         }
         return ss.str();
     }
+
+    /**
+     *  Read a non-negative search tunable from the config, keeping its
+     *  current value if the key is missing or can't be parsed.
+     *
+     *  \param cfg          The parsed config file.
+     *  \param key          The key to read.
+     *  \param value        The tunable to set.
+     */
+    void read_tunable(const Config& cfg, const std::string& key, int* value) {
+        Config::const_iterator it = cfg.find(key);
+        if (it == cfg.end()) return;
+        try {
+            int parsed = std::stoi(it->second);
+            if (parsed < 0) throw std::out_of_range(key);
+            *value = parsed;
+        }
+        catch(...) {
+            std::cerr << "Unable to parse config file for " << key << "."
+                      << std::endl << "Using default value of " << *value
+                      << "." << std::endl;
+        }
+    }
 }
 
 void Player::read_config(std::string filename) {
@@ -113,6 +149,122 @@ void Player::read_config(std::string filename) {
                   << iterative_deepening_timeout << "." << std::endl;
     }
 
+    // number of search threads
+    it = cfg.find("THREADS");
+    if (it != cfg.end()) {
+        try {
+            int threads = std::stoi(it->second);
+            if (threads <= 0) throw std::out_of_range("THREADS");
+            searcher->set_threads(threads);
+        }
+        catch(...) {
+            std::cerr << "Unable to parse config file for THREADS."
+                      << std::endl << "Using default value of 1."
+                      << std::endl;
+        }
+    }
+
+    // transposition table size
+    it = cfg.find("HASH_SIZE");
+    if (it != cfg.end()) {
+        try {
+            int hash_size = std::stoi(it->second);
+            if (hash_size <= 0) throw std::out_of_range("HASH_SIZE");
+            trans_table.resize(hash_size);
+        }
+        catch(...) {
+            std::cerr << "Unable to parse config file for HASH_SIZE."
+                      << std::endl << "Using default value of "
+                      << DEFAULT_TABLE_MB << "." << std::endl;
+        }
+    }
+
+    // null-move pruning: ON, OFF or VERIFY
+    it = cfg.find("NULL_MOVE");
+    if (it != cfg.end()) {
+        search_options_t opts = searcher->get_options();
+        std::string parsed_null_move = upper_string(it->second);
+        if (parsed_null_move == "ON" || parsed_null_move == "VERIFY") {
+            opts.null_move = true;
+            opts.verify_null_move = (parsed_null_move == "VERIFY");
+            searcher->set_options(opts);
+        } else if (parsed_null_move == "OFF") {
+            opts.null_move = false;
+            searcher->set_options(opts);
+        } else {
+            std::cerr << "Unable to parse config file for NULL_MOVE."
+                      << std::endl << "Using default value of ON."
+                      << std::endl;
+        }
+    }
+
+    // late move reductions: ON or OFF
+    it = cfg.find("LATE_MOVE_REDUCTIONS");
+    if (it != cfg.end()) {
+        search_options_t opts = searcher->get_options();
+        std::string parsed_lmr = upper_string(it->second);
+        if (parsed_lmr == "ON" || parsed_lmr == "OFF") {
+            opts.late_move_reductions = (parsed_lmr == "ON");
+            searcher->set_options(opts);
+        } else {
+            std::cerr << "Unable to parse config file for "
+                      << "LATE_MOVE_REDUCTIONS." << std::endl
+                      << "Using default value of ON." << std::endl;
+        }
+    }
+
+    // aspiration windows: ON or OFF
+    it = cfg.find("ASPIRATION_WINDOWS");
+    if (it != cfg.end()) {
+        search_options_t opts = searcher->get_options();
+        std::string parsed_aspiration = upper_string(it->second);
+        if (parsed_aspiration == "ON" || parsed_aspiration == "OFF") {
+            opts.aspiration_windows = (parsed_aspiration == "ON");
+            searcher->set_options(opts);
+        } else {
+            std::cerr << "Unable to parse config file for "
+                      << "ASPIRATION_WINDOWS." << std::endl
+                      << "Using default value of ON." << std::endl;
+        }
+    }
+
+    // forward pruning: ON or OFF
+    it = cfg.find("FORWARD_PRUNING");
+    if (it != cfg.end()) {
+        search_options_t opts = searcher->get_options();
+        std::string parsed_pruning = upper_string(it->second);
+        if (parsed_pruning == "ON" || parsed_pruning == "OFF") {
+            opts.forward_pruning = (parsed_pruning == "ON");
+            searcher->set_options(opts);
+        } else {
+            std::cerr << "Unable to parse config file for "
+                      << "FORWARD_PRUNING." << std::endl
+                      << "Using default value of ON." << std::endl;
+        }
+    }
+
+    // forward pruning margins, in centipawns per ply of depth
+    search_options_t opts = searcher->get_options();
+    read_tunable(cfg, "REVERSE_FUTILITY_MARGIN",
+                 &opts.reverse_futility_margin);
+    read_tunable(cfg, "RAZOR_MARGIN", &opts.razor_margin);
+    read_tunable(cfg, "FUTILITY_MARGIN", &opts.futility_margin);
+    read_tunable(cfg, "LATE_MOVE_COUNT", &opts.late_move_count);
+    searcher->set_options(opts);
+
+    // pondering: ON or OFF
+    it = cfg.find("PONDER");
+    if (it != cfg.end()) {
+        std::string parsed_ponder = upper_string(it->second);
+        if (parsed_ponder == "ON" || parsed_ponder == "OFF") {
+            ponder = (parsed_ponder == "ON");
+        } else {
+            std::cerr << "Unable to parse config file for PONDER."
+                      << std::endl << "Using default value of ON."
+                      << std::endl;
+        }
+    }
+
     // user colour
     it = cfg.find("USER_COLOUR");
     if (it != cfg.end()) {
@@ -146,7 +298,7 @@ std::vector<std::string> Player::getHistorySAN() const {
     return move_history_san;
 }
 
-TransTable Player::getTable() const {
+const TransTable& Player::getTable() const {
     return trans_table;
 }
 
@@ -175,10 +327,12 @@ void Player::print_history_san(std::ostream& cout) const {
 }
 
 void Player::print_table(std::ostream& cout) {
-    TransTable::iterator it;
-    for (it = trans_table.begin(); it != trans_table.end(); it++) {
-        cout << it->first << ":" << std::endl
-             << it->second << std:: endl;
+    record_t rec;
+    uint64_t sig;
+    for (size_t i = 0; i < trans_table.capacity(); i++) {
+        if (!trans_table.at(i, &sig, &rec)) continue;
+        cout << static_cast<uint32_t>(sig) << ":" << std::endl
+             << rec << std:: endl;
     }
 }
 
@@ -193,17 +347,18 @@ void Player::print_board(std::ostream& cout) const {
 void Player::save_table(std::string filename) {
     std::ofstream fil(filename);
     record_t rec;
-    TransTable::iterator it;
-    for (it = trans_table.begin(); it != trans_table.end(); it++) {
-        fil << it->first << ",";
-        rec = it->second;
-        fil << rec.signature << ","
+    uint64_t sig;
+    for (size_t i = 0; i < trans_table.capacity(); i++) {
+        if (!trans_table.at(i, &sig, &rec)) continue;
+        fil << static_cast<uint32_t>(sig) << ",";
+        fil << sig << ","
             << + rec.best_move << ","
             << + rec.depth << ","
             << rec.score << ","
-            << + rec.age << ","
-            << (rec.flag == EXACT ? "EXACT" :
-                rec.flag == LOWER ? "LOWER" :
+            << rec.eval << ","
+            << + rec.generation() << ","
+            << (rec.flag() == EXACT ? "EXACT" :
+                rec.flag() == LOWER ? "LOWER" :
                 "UPPER") << std::endl;
     }
     fil.close();
@@ -214,13 +369,12 @@ void Player::load_table(std::string filename) {
     std::ifstream fil(filename);
     std::stringstream num;
     int comma_1, comma_2, length;
-    record_t rec;
     uint32_t ind;
     uint64_t sig;
     move_t move;
     uint8_t depth;
     value_t ibv;
-    uint8_t age;
+    value_t eval;
     std::string flag_str;
     valueType flag;
 
@@ -261,15 +415,18 @@ void Player::load_table(std::string filename) {
         comma_1 = comma_2 + 1;
         comma_2 = line.find(",", comma_1);
         length = comma_2 - comma_1;
-        age = std::stoi(line.substr(comma_1, length));
+        eval = std::stoi(line.substr(comma_1, length));
+
+        // skip the generation: loaded records belong to the next search
+        comma_1 = comma_2 + 1;
+        comma_2 = line.find(",", comma_1);
 
         comma_1 = comma_2 + 1;
         flag_str = line.substr(comma_1);
         flag = flag_str == "EXACT" ? EXACT :
                flag_str == "LOWER" ? LOWER : UPPER;
 
-        rec = {sig, move, depth, ibv, age, flag};
-        trans_table[ind] = rec;
+        trans_table.save(sig, move, ibv, eval, depth, flag);
     }
 }
 
@@ -319,10 +476,37 @@ move_t Player::search(int timeout) {
     return searcher->search(reinterpret_cast<Board*>(this), timeout, true);
 }
 
+void Player::start_pondering(int timeout) {
+    if (!ponder || gameover()) return;
+    move_t reply = searcher->expected_move(*this);
+    if (!reply) return;
+    Board after(*this);
+    after.doMoveInPlace(reply);
+    search_limits_t limits;
+    limits.max_time = static_cast<int64_t>(timeout) * 1000;
+    limits.ponder = true;
+    searcher->start_search(after, limits);
+    ponder_move = reply;
+}
+
+bool Player::end_pondering(move_t move) {
+    if (!ponder_move) return false;
+    bool hit = (move == ponder_move);
+    ponder_move = 0;
+    if (hit) {
+        searcher->ponder_hit();
+    } else {
+        searcher->stop_search();
+        searcher->wait();
+    }
+    return hit;
+}
+
 void Player::play(colour playerSide, int timeout) {
 //    init();
     move_t comp_move;
     move_t player_move;
+    bool pondered = false;
     int num_moves = 0;
     colour movingSide;
 
@@ -342,15 +526,18 @@ void Player::play(colour playerSide, int timeout) {
 
         if (movingSide == playerSide) {
             player_move = input_move_SAN();
+            pondered = end_pondering(player_move);
             doMoveInPlace(player_move);
         } else {
             std::cout << "Computer thinking...    " << std::endl;
             std::cout << "Timeout: " << iterative_deepening_timeout
                       << std::endl;
-            comp_move = search(timeout);
+            comp_move = pondered ? searcher->wait() : search(timeout);
+            pondered = false;
             std::cout << "Computer move: " << mtos(comp_move)
                       << std::endl;
             doMoveInPlace(comp_move);
+            start_pondering(timeout);
         }
         num_moves++;
     }
@@ -377,6 +564,7 @@ void Player::play(colour playerSide, int timeout) {
 void Player::play() {
     move_t comp_move;
     move_t player_move;
+    bool pondered = false;
     int num_moves = 0;
     colour movingSide;
 
@@ -390,15 +578,18 @@ void Player::play() {
         getSide(&movingSide);
         if (movingSide == user_colour) {
             player_move = input_move_SAN();
+            pondered = end_pondering(player_move);
             doMoveInPlace(player_move);
         } else {
             std::cout << "Computer thinking...    " << std::endl;
             std::cout << "Timeout: " << iterative_deepening_timeout
                       << std::endl;
-            comp_move = search();
+            comp_move = pondered ? searcher->wait() : search();
+            pondered = false;
             std::cout << "Computer move: " << SAN_pre_move(comp_move)
                       << std::endl;
             doMoveInPlace(comp_move);
+            start_pondering(iterative_deepening_timeout);
         }
         num_moves++;
     }
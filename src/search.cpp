@@ -7,16 +7,19 @@ LICENSE file in the root directory of this source tree.
 */
 #include "search.h"
 
-#include <time.h>
-
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
-#include <utility>
+#include <cstdlib>
+#include <memory>
+#include <thread>
 #include <vector>
 
 #include "action.h"
 #include "board.h"
+#include "eval.h"
 #include "move.h"
+#include "picker.h"
 #include "play.h"
 #include "typedefs.h"
 
@@ -24,337 +27,402 @@ LICENSE file in the root directory of this source tree.
 
 namespace chessCore {
 
-std::ostream& operator<<(std::ostream &out, const record_t &rec) {
-    out << "Best/refutation move:     " << mtos(rec.best_move) << std::endl
-        << "Depth searched:           " << +rec.depth << std::endl
-        << "Clock when last searched: " << +rec.age << std::endl
-        << "Bound flag:               " << (rec.flag == UPPER ? "Upper\n" :
-                                            rec.flag == LOWER ? "Lower\n" :
-                                                                "Exact\n")
-
-        << "Value:                    " << rec.score << std::endl;
-    return out;
+uint8_t lmr_reductions[LMR_MAX_DEPTH][LMR_MAX_MOVES];
+
+void search_stats_t::add(const search_stats_t& other) {
+    nodes += other.nodes;
+    qnodes += other.qnodes;
+    reverse_futility_prunes += other.reverse_futility_prunes;
+    razor_prunes += other.razor_prunes;
+    futility_prunes += other.futility_prunes;
+    late_move_prunes += other.late_move_prunes;
+    aspiration_searches += other.aspiration_searches;
+    fail_lows += other.fail_lows;
+    fail_highs += other.fail_highs;
 }
 
+void init_reductions() {
+    for (int depth = 0; depth < LMR_MAX_DEPTH; depth++) {
+        for (int moves = 0; moves < LMR_MAX_MOVES; moves++) {
+            if (depth == 0 || moves == 0) {
+                lmr_reductions[depth][moves] = 0;
+                continue;
+            }
+            double r = 0.75 + std::log(depth) * std::log(moves) / 2.25;
+            lmr_reductions[depth][moves] = static_cast<uint8_t>(r);
+        }
+    }
+}
 
-Searcher::Searcher() {
-    trans_table = new TransTable;
+Searcher::Searcher() : Searcher(new TransTable) {
+    owns_table = true;
 }
 
 Searcher::Searcher(TransTable* tt) {
     trans_table = tt;
+    owns_table = false;
+    num_threads = 1;
+    thread_id = 0;
+    stop_flag = false;
+    stop = &stop_flag;
+    max_depth = 0;
+    max_nodes = 0;
+    node_counter = 0;
+    total_nodes = &node_counter;
+    ponder_flag = false;
+    pondering = &ponder_flag;
+    ponder_timing = false;
+    completed_depth = 0;
+    heuristics.clear();
+    null_min_ply = 0;
+    worker_move = 0;
+    best_move_so_far = 0;
 }
 
 Searcher::~Searcher() {
-    delete trans_table;
+    if (worker.joinable()) {
+        stop_search();
+        worker.join();
+    }
+    if (owns_table) delete trans_table;
+}
+
+void Searcher::set_threads(int n) {
+    num_threads = std::max(n, 1);
+}
+
+void Searcher::set_options(const search_options_t& opts) {
+    options = opts;
 }
 
-void Searcher::set_timeout(int time) {
-    search_start_time = clock();
-    search_end_time = search_start_time + time * CLOCKS_PER_SEC;
+const search_options_t& Searcher::get_options() const {
+    return options;
+}
+
+void Searcher::new_game() {
+    trans_table->clear();
+    heuristics.clear();
+}
+
+const search_stats_t& Searcher::get_stats() const {
+    return stats;
 }
 
 void Searcher::kill_search() {
-    search_end_time = clock();
+    stop->store(true);
 }
 
-void Searcher::prune_table(uint8_t age) {
-    TransTable::const_iterator it;
-    for (it=trans_table->cbegin(); it != trans_table->cend();) {
-        if (it->second.age < age) {
-            trans_table->erase(it++);
-        } else {
-            ++it;
-        }
-    }
+double Searcher::elapsed() const {
+    return time_manager.elapsed();
 }
 
-value_t Searcher::quiesce(Board* b, value_t alpha, value_t beta) {
+int Searcher::reduction(const Board* b, uint8_t depth, int move_number,
+                        bool pv_node, bool in_check, bool gives_check,
+                        move_t move) const {
+    if (!options.late_move_reductions || depth < 3 || in_check) return 0;
+    if (move_number <= (pv_node ? 4 : 2)) return 0;
+    if (is_capture(move) || is_promotion(move) || gives_check) return 0;
+
     colour side;
     b->getSide(&side);
-    value_t stand_pat = b->getValue() * ((side == white) ? 1 : -1);
-    if (stand_pat >= beta) return beta;
-    if (stand_pat > alpha) alpha = stand_pat;
-
+    int r = lmr_reductions[std::min<int>(depth, LMR_MAX_DEPTH - 1)]
+                          [std::min(move_number, LMR_MAX_MOVES - 1)];
+    if (pv_node) r--;
+    // moves that have caused cutoffs elsewhere are reduced less
+    colour mover = flipColour(side);
+    r -= heuristics.history[mover][from_sq(move)][to_sq(move)] /
+         (MAX_HISTORY / 2);
+    // always leave at least one ply before the quiescence search
+    return std::max(0, std::min(r, depth - 2));
+}
 
-    MoveList captures = b->gen_captures();
-    Board* child;
-    value_t score;
+bool Searcher::prune_node(Board* b, uint8_t depth, value_t alpha,
+                          value_t beta, value_t static_eval, value_t* score) {
+    if (depth <= REVERSE_FUTILITY_DEPTH &&
+        static_eval - options.reverse_futility_margin * depth >= beta) {
+        stats.reverse_futility_prunes++;
+        *score = beta;
+        return true;
+    }
+    if (depth <= RAZOR_DEPTH &&
+        static_eval + options.razor_margin * depth <= alpha) {
+        // only trust it if no capture gets us back to alpha either
+        value_t q = quiesce(b, alpha, beta);
+        if (q <= alpha) {
+            stats.razor_prunes++;
+            *score = q;
+            return true;
+        }
+    }
+    return false;
+}
 
-    for (move_t capture : captures) {
-        child = doMove(b, capture);
-        score = - quiesce(child, -beta, -alpha);
-        if (score >= beta) return beta;
-        if (score > alpha) alpha = score;
+bool Searcher::prune_move(uint8_t depth, int move_number, bool futile,
+                          bool gives_check, move_t move) {
+    if (move_number == 1 || is_capture(move) || is_promotion(move) ||
+        gives_check) {
+        return false;
     }
 
-    return alpha;
+    if (futile) {
+        stats.futility_prunes++;
+        return true;
+    }
+    if (depth <= LATE_MOVE_PRUNING_DEPTH &&
+        move_number > options.late_move_count + depth * depth) {
+        stats.late_move_prunes++;
+        return true;
+    }
+    return false;
 }
 
 namespace {
 bool table_lookup(uint64_t sig,
-                  uint32_t ind,
                   TransTable* tt,
                   record_t* rec) {
-    TransTable::iterator it = tt->find(ind);
-    if (it == tt->end()) return false;
-    if (it->second.signature != sig) return false;
-    *rec = it->second;
-    return true;
+    return tt->probe(sig, rec);
 }
 
 void table_save(uint64_t sig,
-                uint32_t ind,
                 move_t best_move,
                 uint8_t depth,
                 value_t score,
-                uint8_t age,
+                value_t eval,
                 valueType flag,
                 TransTable* tt) {
-    record_t rec({sig, best_move, depth, score, age, flag});
-    tt->operator[](ind) = rec;
-}
-
-class CompMoves {
- private:
-    Board* b;
-    colour side;
-    TransTable* trans_table;
-
-    value_t get_value(move_t move) {
-        uint64_t child_hash = b->childHash(move);
-        uint32_t child_index = static_cast<uint32_t>(child_hash);
-        record_t rec;
-        if (table_lookup(child_hash, child_index, trans_table, &rec)) {
-            return rec.score;
-        } else {
-            Board* child = doMove(b, move);
-            return child->getValue() * (side == white ? 1 : -1);
-        }
-    }
-
- public:
-    CompMoves(Board* curboard, TransTable* tt) {
-        b = curboard;
-        b->getSide(&side);
-        trans_table = tt;
-    }
-
-    bool operator()(move_t move1, move_t move2) {
-//        if (is_capture(move1) && !is_capture(move2)) {
-//            return true;
-//        } else if (!is_capture(move1) && is_capture(move2)) {
-//            return false;
-//        } else {
-            return get_value(move1) > get_value(move2);
-//        }
-    }
-};
-
-/**
- *  Given an array of moves and a preferred "best move" to search first,
- *  reorder the array so that the move is searched first.
- *
- *  \param moves        A pointer to an array of moves to search.
- *  \param b            A pointer to the board we're searching from.
- *  \param tt           A pointer to the transposition table to use.
- *  \param first_move   If given, the move we want to search first.
- *  \param second_move  If given, the move we want to search second.
- */
-void reorder_moves(MoveList* moves, Board* b, TransTable*tt,
-                   move_t first_move = 0, move_t second_move = 0) {
-    MoveList::iterator it;
-    int start = 0;
-    if (first_move) {
-        it = std::find(moves->begin(), moves->end(), first_move);
-        if (it != moves->end()) {
-            std::iter_swap(it, moves->begin());
-            start++;
-        }
-    }
-    if ((second_move) && (second_move != first_move)) {
-        it = std::find(moves->begin(), moves->end(), second_move);
-        if (it != moves->end()) {
-            std::iter_swap(it, moves->begin()+start);
-            start++;
-        }
-    }
-    std::sort(moves->begin()+start, moves->end(), CompMoves(b, tt));
-}
-
-double time_diff(clock_t start_time) {
-    return static_cast<double>(clock() - start_time) /
-                static_cast<double>(CLOCKS_PER_SEC);
-}
-
-double time_diff(clock_t start_time, clock_t end_time) {
-    return static_cast<double>(end_time - start_time) /
-                static_cast<double>(CLOCKS_PER_SEC);
+    tt->save(sig, best_move, score, eval, depth, flag);
 }
 
 }   // namespace
 
 
-value_t Searcher::principal_variation(Board* b, uint8_t depth,
-                                    value_t alpha, value_t beta,
-                                    move_t first_move) {
+value_t Searcher::quiesce(Board* b, value_t alpha, value_t beta) {
+    count_node();
+    stats.qnodes++;
     colour side;
     b->getSide(&side);
-    value_t ret;
     uint64_t sig;
-    uint32_t ind;
-    move_t bestMove = 0;
-    uint8_t age;
     b->getHash(&sig);
-    ind = (uint32_t)sig;
-    b->getFullClock(&age);
     record_t record;
+    value_t stand_pat;
 
-    // lookup
-    if (table_lookup(sig, ind, trans_table, &record)) {
-        bestMove = record.best_move;
-        if (record.depth >= depth) {
-            switch (record.flag) {
-                case UPPER:
-                    // upper bound
-                    beta = std::min(beta, record.score);
-                    break;
-                case LOWER:
-                    // lower bound
-                    alpha = std::max(alpha, record.score);
-                    break;
-                case EXACT:
-                    // exact
-                    return record.score;
-            }
-            if (alpha >= beta) {
+    bool found = table_lookup(sig, trans_table, &record);
+    if (found) {
+        // every record has been searched at least as deep as this
+        switch (record.flag()) {
+            case EXACT:
                 return record.score;
-            }
+            case LOWER:
+                if (record.score >= beta) return beta;
+                break;
+            case UPPER:
+                if (record.score <= alpha) return alpha;
+                break;
+            default:
+                break;
         }
+        stand_pat = record.eval;
+    } else {
+        stand_pat = b->getValue() * ((side == white) ? 1 : -1);
     }
+    // don't overwrite the result of a deeper search
+    bool save = !found || record.depth == 0;
 
-    if (clock() > search_end_time || depth <= 0) {
-        ret = quiesce(b, alpha, beta);
-        return ret;
-    }
-
-    bool bSearchPv = true;
-    Board* child;
-    value_t score = -VAL_INFINITY;
-
-    MoveList moves = b->gen_legal_moves();
-    if (moves.empty()) {
-        if (b->is_checkmate()) {
-            ret = score * ((side == white) ? 1 : -1);
-        } else {
-            ret = 0;
+    if (stand_pat >= beta) {
+        if (save) {
+            table_save(sig, 0, 0, beta, stand_pat, LOWER, trans_table);
         }
-        table_save(sig, ind, bestMove, depth, ret, age, EXACT, trans_table);
-        return ret;
+        return beta;
     }
+    value_t alphaOrig = alpha;
+    if (stand_pat > alpha) alpha = stand_pat;
+    bool delta_pruning = b->has_non_pawn_material(side);
 
-    reorder_moves(&moves, b, trans_table, first_move, bestMove);
-
-    for (move_t move : moves) {
-        child = doMove(b, move);
-        if (clock() > search_end_time) break;
+    MovePicker picker(b);
+    move_t capture;
+    move_t best_capture = 0;
+    undo_t undo;
+    value_t score;
 
-        if (bSearchPv) {
-            score = - principal_variation(child, depth-1, -beta, -alpha);
-        } else {
-            score = - principal_variation(child, depth - 1, -alpha - 1, -alpha);
-            if (score > alpha) {
-                score = - principal_variation(child, depth - 1, -beta, -alpha);
+    while ((capture = picker.next())) {
+        if (delta_pruning) {
+            int gain = is_ep_capture(capture) ? pieceValues[0][pawn] :
+                       is_capture(capture) ?
+                       std::abs(pieceValues[0][b->piece_at(to_sq(capture))]) :
+                       0;
+            if (is_promotion(capture)) {
+                gain += pieceValues[0][which_promotion(capture)] -
+                        pieceValues[0][pawn];
             }
+            if (stand_pat + gain + DELTA_MARGIN <= alpha) continue;
         }
-
+        b->makeMove(capture, &undo);
+        score = - quiesce(b, -beta, -alpha);
+        b->unmakeMove(capture, undo);
         if (score >= beta) {
-            // lower bound
-            table_save(sig, ind, move, depth, beta, age, LOWER, trans_table);
+            if (save) {
+                table_save(sig, capture, 0, beta, stand_pat, LOWER,
+                           trans_table);
+            }
             return beta;
         }
         if (score > alpha) {
-            // upper bound
             alpha = score;
-            bSearchPv = false;
-            bestMove = move;
+            best_capture = capture;
         }
     }
-    if (bSearchPv) {
-        // exact
-        table_save(sig, ind, bestMove, depth, alpha, age, EXACT, trans_table);
-    } else {
-        // upper bound
-        table_save(sig, ind, bestMove, depth, alpha, age, UPPER, trans_table);
+
+    if (save) {
+        table_save(sig, best_capture, 0, alpha, stand_pat,
+                   (alpha > alphaOrig) ? EXACT : UPPER, trans_table);
     }
     return alpha;
 }
 
+template <nodeType node>
 value_t Searcher::negamax_alphabeta(Board* b, uint8_t depth,
                                     value_t alpha, value_t beta,
+                                    int ply, move_t prev_move,
                                     move_t first_move) {
+    constexpr bool pv_node = (node != nonPvNode);
+    count_node();
     colour side;
     b->getSide(&side);
     value_t ret;
     value_t alphaOrig = alpha;
     uint64_t sig;
-    uint32_t ind;
     move_t bestMove = 0;
-    uint8_t age;
     b->getHash(&sig);
-    ind = (uint32_t)sig;
-    b->getFullClock(&age);
+    value_t static_eval;
     record_t record;
 
     // lookup
-    if (table_lookup(sig, ind, trans_table, &record)) {
+    bool found = table_lookup(sig, trans_table, &record);
+    if (found) {
         bestMove = record.best_move;
-        if (record.depth >= depth) {
-            switch (record.flag) {
-                case EXACT:
-                    return record.score;
-                    break;
-                case LOWER:
-                    alpha = std::max(alpha, record.score);
-                    break;
-                case UPPER:
-                    beta = std::min(beta, record.score);
-                    break;
-                default:
-                    break;
-            }
-            if (alpha >= beta) {
-                table_save(sig, ind, bestMove, depth, record.score,
-                           age, LOWER, trans_table);
+        // the root is always searched, to get a fresh best move and score
+        if (node != rootNode && record.depth >= depth) {
+            if (pv_node) {
+                switch (record.flag()) {
+                    case EXACT:
+                        return record.score;
+                    case LOWER:
+                        alpha = std::max(alpha, record.score);
+                        break;
+                    case UPPER:
+                        beta = std::min(beta, record.score);
+                        break;
+                    default:
+                        break;
+                }
+                if (alpha >= beta) return record.score;
+            } else if (record.flag() == EXACT ||
+                       (record.flag() == LOWER && record.score >= beta) ||
+                       (record.flag() == UPPER && record.score <= alpha)) {
+                // a null window is only ever above or below the score
                 return record.score;
             }
         }
     }
 
-    if (clock() > search_end_time || depth <= 0) {
-        ret = quiesce(b, alpha, beta);      // check this
-        table_save(sig, ind, bestMove, depth, record.score,
-                   age, LOWER, trans_table);
-        return ret;
+    if (out_of_time() || depth <= 0) {
+        // the quiescence search stores its own result
+        return quiesce(b, alpha, beta);
     }
-
-    Board* child;
-
-    MoveList moves = b->gen_legal_moves();
-    if (moves.empty()) {
-        ret = (b->is_checkmate()) ? -VAL_INFINITY : 0;
-        table_save(sig, ind, bestMove, depth, ret, age, EXACT, trans_table);
-        return ret;
+    static_eval = found ? record.eval :
+                  b->getValue() * ((side == white) ? 1 : -1);
+
+    undo_t undo;
+    bool in_check = b->is_check(side);
+    bool can_prune = !pv_node && options.forward_pruning && !in_check;
+    bool futile = false;
+
+    if (!pv_node) {
+        if (can_prune &&
+            prune_node(b, depth, alpha, beta, static_eval, &ret)) {
+            return ret;
+        }
+        futile = can_prune && depth <= FUTILITY_DEPTH &&
+                 static_eval + options.futility_margin * depth <= alpha;
+
+        // null move: prev_move is 0 after another null move
+        if (options.null_move && depth >= 3 && prev_move &&
+            ply >= null_min_ply && static_eval >= beta && !in_check &&
+            b->has_non_pawn_material(side)) {
+            // adaptive reduction: more at higher depths
+            uint8_t reduction = (depth > 6) ? 3 : 2;
+            b->makeNullMove(&undo);
+            value_t null_score = - negamax_alphabeta<nonPvNode>(
+                b, depth - 1 - reduction, -beta, -beta + 1, ply + 1, 0);
+            b->unmakeNullMove(undo);
+
+            if (null_score >= beta && !out_of_time()) {
+                bool verified = true;
+                if (options.verify_null_move) {
+                    // search this node again, without null moves for a while
+                    int saved_min_ply = null_min_ply;
+                    null_min_ply = ply + 3 * (depth - reduction) / 4;
+                    verified = negamax_alphabeta<nonPvNode>(
+                        b, depth - reduction, beta - 1, beta, ply,
+                        prev_move) >= beta;
+                    null_min_ply = saved_min_ply;
+                }
+                if (verified) {
+                    // don't trust a mate score from a null-move search
+                    table_save(sig, bestMove, depth, beta, static_eval, LOWER,
+                               trans_table);
+                    return beta;
+                }
+            }
+        }
     }
 
-    reorder_moves(&moves, b, trans_table, first_move, bestMove);
+    MovePicker picker(b, first_move, bestMove, &heuristics, ply, prev_move);
+    move_t move;
+    int legal_moves = 0;
+    move_t quiets_tried[MAX_MOVES];
+    int num_quiets = 0;
 
     value_t score, value = -VAL_INFINITY;
 
-    for (move_t move : moves) {
-        child = doMove(b, move);
-        if (clock() > search_end_time) break;
-        score = - negamax_alphabeta(child, depth - 1, -beta, -alpha);
+    while ((move = picker.next())) {
+        legal_moves++;
+        if (out_of_time()) break;
+        // only the quiet moves after the first can be pruned or reduced;
+        // they are tested before the move is made, so that the pruned ones
+        // never are
+        bool gives_check = false;
+        if (legal_moves > 1 && !is_capture(move) && !is_promotion(move)) {
+            gives_check = b->gives_check(move);
+        }
+        if (can_prune &&
+            prune_move(depth, legal_moves, futile, gives_check, move)) {
+            continue;
+        }
+        b->makeMove(move, &undo);
+        if (pv_node && legal_moves == 1) {
+            score = - negamax_alphabeta<pvNode>(b, depth - 1, -beta, -alpha,
+                                                ply + 1, move);
+        } else {
+            // every other move only has to be shown to be no better
+            int r = reduction(b, depth, legal_moves, pv_node, in_check,
+                              gives_check, move);
+            score = - negamax_alphabeta<nonPvNode>(b, depth - 1 - r,
+                                                   -alpha - 1, -alpha,
+                                                   ply + 1, move);
+            if (score > alpha && r) {
+                // the reduced search failed high, so search to full depth
+                score = - negamax_alphabeta<nonPvNode>(b, depth - 1,
+                                                       -alpha - 1, -alpha,
+                                                       ply + 1, move);
+            }
+            if (pv_node && score > alpha && score < beta) {
+                // a new best move: get its exact score
+                score = - negamax_alphabeta<pvNode>(b, depth - 1, -beta,
+                                                    -alpha, ply + 1, move);
+            }
+        }
+        b->unmakeMove(move, undo);
         if (score > value) {
             bestMove = move;
             value = score;
@@ -362,70 +430,149 @@ value_t Searcher::negamax_alphabeta(Board* b, uint8_t depth,
         if (alpha < value) {
             alpha = value;
         }
-        if (alpha >= beta) break;
+        bool quiet = !is_capture(move) && !is_promotion(move);
+        if (alpha >= beta) {
+            if (quiet) {
+                heuristics.update(side, ply, depth, move, prev_move,
+                                  quiets_tried, num_quiets);
+            }
+            break;
+        }
+        if (quiet) quiets_tried[num_quiets++] = move;
+    }
+    if (out_of_time()) {
+        // the search was stopped part way through the moves, so the value
+        // is meaningless: don't let it into the table
+        return 0;
+    }
+    if (!legal_moves) {
+        ret = (b->is_check(side)) ? -VAL_INFINITY : 0;
+        table_save(sig, bestMove, depth, ret, static_eval, EXACT, trans_table);
+        return ret;
     }
     if (value <= alphaOrig) {
-        table_save(sig, ind, bestMove, depth, value, age, UPPER, trans_table);
+        table_save(sig, bestMove, depth, value, static_eval,
+                   UPPER, trans_table);
     } else if (value >= beta) {
-        table_save(sig, ind, bestMove, depth, value, age, LOWER, trans_table);
+        table_save(sig, bestMove, depth, value, static_eval,
+                   LOWER, trans_table);
     } else {
-        table_save(sig, ind, bestMove, depth, value, age, EXACT, trans_table);
+        table_save(sig, bestMove, depth, value, static_eval,
+                   EXACT, trans_table);
     }
     return value;
 }
 
+std::vector<move_t> Searcher::get_pv(const Board& root, move_t first_move,
+                                    int max_length) const {
+    std::vector<move_t> pv;
+    Board b(root);
+    move_t move = first_move;
+    record_t rec;
+    uint64_t hsh;
+    undo_t undo;
+    while (move && static_cast<int>(pv.size()) < max_length &&
+           b.is_pseudo_legal(move) && b.is_legal(move)) {
+        pv.push_back(move);
+        b.makeMove(move, &undo);
+        b.getHash(&hsh);
+        move = table_lookup(hsh, trans_table, &rec) ? rec.best_move : 0;
+    }
+    return pv;
+}
 
-move_t Searcher::iterative_deepening_negamax(Board* b,
-                                             int timeout,
-                                             bool cutoff) {
-    set_timeout(timeout);
-    uint8_t age;
-    b->getFullClock(&age);
-#if DEBUG
-    std::cerr << "Size of transposition table: "
-              << trans_table->size() << std::endl;
-#endif
-    if (age > 3) {
-        prune_table(age - 3);
-#if DEBUG
-    std::cerr << "Size of transposition table after pruning: "
-              << trans_table->size() << std::endl;
-#endif
+value_t Searcher::aspiration_search(Board* b, uint8_t depth,
+                                    value_t prev_score, move_t first_move) {
+    int delta = ASPIRATION_WINDOW;
+    int alpha = -VAL_INFINITY;
+    int beta = VAL_INFINITY;
+    // there's no sense in a window around a mate score
+    if (options.aspiration_windows && depth >= ASPIRATION_MIN_DEPTH &&
+        std::abs(prev_score) < VAL_INFINITY) {
+        alpha = std::max<int>(prev_score - delta, -VAL_INFINITY);
+        beta = std::min<int>(prev_score + delta, VAL_INFINITY);
+        stats.aspiration_searches++;
     }
-    uint8_t depth = 1;
+
+    while (true) {
+        value_t score = negamax_alphabeta<rootNode>(b, depth, alpha, beta,
+                                                    0, 0, first_move);
+        if (out_of_time()) return score;
+
+        // widen just the side that failed, further each time
+        delta *= 2;
+        if (score <= alpha && alpha > -VAL_INFINITY) {
+            stats.fail_lows++;
+            alpha = (delta > ASPIRATION_MAX_WINDOW) ? -VAL_INFINITY :
+                    std::max<int>(score - delta, -VAL_INFINITY);
+        } else if (score >= beta && beta < VAL_INFINITY) {
+            stats.fail_highs++;
+            beta = (delta > ASPIRATION_MAX_WINDOW) ? VAL_INFINITY :
+                   std::min<int>(score + delta, VAL_INFINITY);
+        } else {
+            return score;
+        }
+    }
+}
+
+move_t Searcher::iterative_deepening_negamax(Board* b) {
+    // helpers start at staggered depths, so that the threads don't all
+    // search the same tree in lockstep
+    uint8_t depth = 1 + thread_id % 2;
     move_t best_move = 0;
     move_t new_move;
-    MoveList moves;
-    int sz;
-    colour side;
     uint64_t hsh;
-    uint32_t ind;
-    b->getSide(&side);
+    record_t rec;
     b->getHash(&hsh);
-    ind = (uint32_t)hsh;
-    value_t alpha = -VAL_INFINITY;
-    value_t beta = VAL_INFINITY;
-
-    while (clock() < search_end_time && depth < 100) {
-        negamax_alphabeta(b, depth, alpha, beta, best_move);
-        new_move = trans_table->operator[](ind).best_move;
+    value_t score = 0;
+    // the number of iterations in a row with the same best move
+    int stability = 0;
+    // for the effective branching factor
+    uint64_t last_nodes = 0, last_iteration_nodes = 0;
+
+    while (!out_of_time() && depth < 100 &&
+           (!max_depth || depth <= max_depth)) {
+        score = aspiration_search(b, depth, score, best_move);
+        new_move = table_lookup(hsh, trans_table, &rec) ? rec.best_move : 0;
+        if (!out_of_time()) completed_depth = depth;
         depth++;
 
         if (new_move) {
+            stability = (new_move == best_move) ? stability + 1 : 0;
             best_move = new_move;
-            moves.push_back(best_move);
+            if (thread_id == 0 && !out_of_time()) {
+                best_move_so_far.store(best_move, std::memory_order_relaxed);
+                if (info_callback) {
+                    search_info_t info;
+                    info.depth = depth - 1;
+                    info.score = score;
+                    // add the nodes this thread hasn't shared yet
+                    info.nodes = total_nodes->load(std::memory_order_relaxed) +
+                                 (stats.nodes & (TIME_CHECK_NODES - 1));
+                    info.time = elapsed();
+                    info.hashfull = trans_table->hashfull();
+                    info.pv = get_pv(*b, best_move, depth - 1);
+                    info_callback(info);
+                }
+            }
 #if DEBUG
-            std::cerr << "Depth searched: " << depth - 1 << "   ("
-                      << time_diff(search_start_time)
-                      << " seconds total)"
-                      << "  (best move so far: "
-                      << b->SAN_pre_move(best_move) << ")" << std::endl;
+            // don't talk over the opponent's turn, or over UCI's info lines
+            if (thread_id == 0 && !ponder_timing && !info_callback) {
+                std::cerr << "Depth searched: " << depth - 1 << "   ("
+                          << elapsed() << " seconds total)"
+                          << "  (" << stats.nodes << " nodes, branching factor "
+                          << (last_iteration_nodes ?
+                              double(stats.nodes - last_nodes) /
+                              last_iteration_nodes : 0.0) << ")"
+                          << "  (best move so far: "
+                          << b->SAN_pre_move(best_move) << ")" << std::endl;
+            }
+            last_iteration_nodes = stats.nodes - last_nodes;
+            last_nodes = stats.nodes;
 #endif
         }
-        sz = moves.size();
-        if (cutoff && ((sz >= 8) || (sz >= 5 &&
-            time_diff(search_start_time) > 20.0))
-            && moves[sz - 1] == moves[sz - 2]) {
+        check_ponder_hit();
+        if (thread_id == 0 && time_manager.soft_limit_reached(stability)) {
             break;
         }
     }
@@ -433,66 +580,172 @@ move_t Searcher::iterative_deepening_negamax(Board* b,
     return best_move;
 }
 
-move_t Searcher::iterative_deepening_pv(Board* b,
-                                        int timeout,
-                                        bool cutoff) {
-    set_timeout(timeout);
-    uint8_t age;
-    b->getFullClock(&age);
-#if DEBUG
-    std::cerr << "Size of transposition table: "
-              << trans_table->size() << std::endl;
-#endif
-    if (age > 3) {
-        prune_table(age - 3);
-#if DEBUG
-    std::cerr << "Size of transposition table after pruning: "
-              << trans_table->size() << std::endl;
-#endif
+move_t Searcher::search(Board* b, int timeout, bool cutoff) {
+    search_limits_t limits;
+    if (cutoff) {
+        limits.max_time = 1000 * int64_t(timeout);
+    } else {
+        limits.move_time = 1000 * int64_t(timeout);
     }
-    uint8_t depth = 1;
-    move_t best_move = 0;
-    move_t new_move;
-    MoveList moves;
-    int sz;
-    colour side;
-    uint64_t hsh;
-    uint32_t ind;
-    b->getSide(&side);
-    b->getHash(&hsh);
-    ind = (uint32_t)hsh;
-    value_t alpha = -VAL_INFINITY;
-    value_t beta = VAL_INFINITY;
+    return search(b, limits);
+}
 
-    while (clock() < search_end_time && depth < 100) {
-        principal_variation(b, depth, alpha, beta, best_move);
-        new_move = trans_table->operator[](ind).best_move;
-        depth++;
+move_t Searcher::search(Board* b, const search_limits_t& limits) {
+    if (worker.joinable()) {
+        stop_search();
+        worker.join();
+    }
+    stop_flag = false;
+    ponder_flag = limits.ponder;
+    return run_search(b, limits);
+}
 
-        if (new_move) {
-            best_move = new_move;
-            moves.push_back(best_move);
+void Searcher::start_search(const Board& b, const search_limits_t& limits) {
+    if (worker.joinable()) {
+        stop_search();
+        worker.join();
+    }
+    // reset here, not on the worker, so that a stop_search() or ponder_hit()
+    // straight after this call can't be lost
+    stop_flag = false;
+    ponder_flag = limits.ponder;
+    best_move_so_far = 0;
+    worker_move = 0;
+    Board root(b);
+    worker = std::thread([this, root, limits]() mutable {
+        worker_move = run_search(&root, limits);
+    });
+}
+
+void Searcher::set_info_callback(info_callback_t callback) {
+    info_callback = callback;
+}
+
+void Searcher::stop_search() {
+    kill_search();
+}
+
+move_t Searcher::wait() {
+    if (!worker.joinable()) return worker_move;
+    worker.join();
+    return worker_move;
+}
+
+bool Searcher::searching() const {
+    return worker.joinable() && !stop->load(std::memory_order_relaxed);
+}
+
+move_t Searcher::get_best_move() const {
+    return best_move_so_far.load(std::memory_order_relaxed);
+}
+
+void Searcher::ponder_hit() {
+    ponder_flag.store(false);
+}
+
+move_t Searcher::expected_move(const Board& b) const {
+    uint64_t hsh;
+    record_t rec;
+    b.getHash(&hsh);
+    if (!table_lookup(hsh, trans_table, &rec)) return 0;
+    move_t move = rec.best_move;
+    return (move && b.is_pseudo_legal(move) && b.is_legal(move)) ? move : 0;
+}
+
+move_t Searcher::run_search(Board* b, const search_limits_t& limits) {
+    this->limits = limits;
+    this->limits.ponder = false;
+    ponder_timing = limits.ponder;
+    if (ponder_timing) {
+        // no limits until the ponder hit, see check_ponder_hit
+        time_manager.start(search_limits_t());
+    } else {
+        time_manager.start(limits);
+    }
+    max_depth = limits.depth;
+    max_nodes = limits.nodes;
+    node_counter = 0;
+    best_move_so_far = 0;
+    completed_depth = 0;
+    null_min_ply = 0;
+    stats = search_stats_t();
 #if DEBUG
-            std::cerr << "Depth searched: " << depth - 1 << "   ("
-                      << time_diff(search_start_time)
-                      << " seconds total)"
-                      << "  (best move so far: "
-                      << b->SAN_pre_move(best_move) << ")" << std::endl;
+    // sampled, so that starting a search doesn't walk the whole table
+    if (!ponder_timing && !info_callback) {
+        std::cerr << "Transposition table usage: " << trans_table->hashfull()
+                  << " per mille" << std::endl;
+    }
 #endif
+    trans_table->new_search();
+    heuristics.new_search();
+
+    // read once, so that the helpers started and collected always agree
+    int threads_to_use = num_threads;
+    std::vector<std::unique_ptr<Searcher>> helpers;
+    std::vector<std::thread> threads;
+    std::vector<move_t> helper_moves(threads_to_use, 0);
+    for (int i = 1; i < threads_to_use; i++) {
+        helpers.push_back(std::make_unique<Searcher>(trans_table));
+        Searcher* helper = helpers.back().get();
+        helper->thread_id = i;
+        helper->options = options;
+        helper->stop = &stop_flag;
+        helper->time_manager = time_manager;
+        helper->max_depth = max_depth;
+        helper->max_nodes = max_nodes;
+        helper->pondering = &ponder_flag;
+        helper->limits = this->limits;
+        helper->ponder_timing = ponder_timing;
+        helper->total_nodes = &node_counter;
+        // each thread makes and unmakes moves on its own copy of the board
+        Board helper_root(*b);
+        move_t* helper_move = &helper_moves[i];
+        threads.push_back(std::thread([helper, helper_root, helper_move]()
+                                      mutable {
+            *helper_move = helper->iterative_deepening_negamax(&helper_root);
+        }));
+    }
+
+    Board root(*b);
+    move_t best_move = iterative_deepening_negamax(&root);
+
+    // the main thread is done, either out of time or cut off early
+    kill_search();
+    for (std::thread& t : threads) t.join();
+
+    // take the move from the deepest completed search
+    uint8_t best_depth = completed_depth;
+    for (size_t i = 0; i < helpers.size(); i++) {
+        const Searcher* helper = helpers[i].get();
+        if (helper->completed_depth > best_depth && helper_moves[i + 1]) {
+            best_depth = helper->completed_depth;
+            best_move = helper_moves[i + 1];
         }
-        sz = moves.size();
-        if (cutoff && ((sz >= 8) || (sz >= 5 &&
-            time_diff(search_start_time) > 20.0)) &&
-            moves[sz - 1] == moves[sz - 2]) {
-            break;
-        }
+        stats.add(helper->stats);
+    }
+    if (!best_move) {
+        // stopped before the first iteration finished
+        MoveList legal = root.gen_legal_moves();
+        if (legal.size()) best_move = legal[0];
+    }
+#if DEBUG
+    // a ponder search that never got its ponder hit stays quiet
+    if (!ponder_timing && !info_callback) {
+        std::cerr << "Nodes searched: " << stats.nodes << " ("
+                  << static_cast<uint64_t>(stats.nodes /
+                                           std::max(elapsed(), 1e-3))
+                  << " nodes per second)" << std::endl
+                  << "Aspiration windows: " << stats.aspiration_searches
+                  << " (" << stats.fail_lows << " fail lows, "
+                  << stats.fail_highs << " fail highs)" << std::endl
+                  << "Forward pruning: " << stats.reverse_futility_prunes
+                  << " reverse futility, " << stats.razor_prunes
+                  << " razoring, " << stats.futility_prunes << " futility, "
+                  << stats.late_move_prunes << " late move" << std::endl;
     }
+#endif
 
     return best_move;
 }
 
-move_t Searcher::search(Board* b, int timeout, bool cutoff) {
-    return iterative_deepening_negamax(b, timeout, cutoff);
-}
-
 }   // namespace chessCore
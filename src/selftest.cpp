@@ -0,0 +1,258 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "selftest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "board.h"
+#include "magic.h"
+#include "move.h"
+#include "search.h"
+#include "table.h"
+#include "timeman.h"
+#include "typedefs.h"
+
+
+namespace chessCore {
+
+namespace {
+/** The seed for the random inputs, so that failures can be repeated. */
+constexpr uint64_t SELFTEST_SEED = 1234;
+
+/**
+ *  Check one slider backend against the ray walker.
+ *
+ *  \param backend      The backend to check. Must be supported.
+ *  \param out          The stream to write the report to.
+ *  \return             True if every lookup matched.
+ */
+bool check_slider_backend(sliderBackend backend, std::ostream& out) {
+    init_magics(backend);
+    std::mt19937_64 rng(SELFTEST_SEED);
+    uint64_t mismatches = 0;
+    for (int i = 0; i < SLIDER_TEST_OCCUPANCIES; i++) {
+        // vary the density, from about a half to about an eighth full
+        bitboard occupancy = rng();
+        for (int j = 0; j < i % 3; j++) occupancy &= rng();
+        for (int sq = 0; sq < 64; sq++) {
+            if (rookAttacks(sq, occupancy) != rookPushNaive(sq, occupancy) ||
+                bishopAttacks(sq, occupancy) !=
+                    bishopPushNaive(sq, occupancy) ||
+                queenAttacks(sq, occupancy) != queenPushNaive(sq, occupancy)) {
+                if (!mismatches++) {
+                    out << "  first mismatch: square " << sq
+                        << ", occupancy " << occupancy << std::endl;
+                }
+            }
+        }
+    }
+    out << "  " << (backend == pextBackend ? "PEXT" : "magic") << " backend: "
+        << SLIDER_TEST_OCCUPANCIES << " occupancies, " << mismatches
+        << " mismatches" << std::endl;
+    return mismatches == 0;
+}
+
+/**
+ *  Count the leaf nodes of the legal move tree.
+ *
+ *  \param b            The board to count from. Restored afterwards.
+ *  \param depth        The depth of the tree, at least 1.
+ *  \return             The number of leaf nodes.
+ */
+uint64_t perft(Board* b, int depth) {
+    MoveList moves = b->gen_legal_moves();
+    if (depth == 1) return moves.size();
+    uint64_t nodes = 0;
+    for (move_t move : moves) {
+        undo_t undo;
+        b->makeMove(move, &undo);
+        nodes += perft(b, depth - 1);
+        b->unmakeMove(move, undo);
+    }
+    return nodes;
+}
+
+/**
+ *  Time move generation with the current slider backend, a few times.
+ *
+ *  \return             The fastest run, in milliseconds.
+ */
+double fastest_perft_time() {
+    double fastest = 0;
+    for (int i = 0; i < SLIDER_SPEED_RUNS; i++) {
+        Board b("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w "
+                "KQkq - 0 1");
+        search_clock::time_point start = search_clock::now();
+        perft(&b, SLIDER_SPEED_DEPTH);
+        double ms = std::chrono::duration<double, std::milli>(
+            search_clock::now() - start).count();
+        fastest = i ? std::min(fastest, ms) : ms;
+    }
+    return fastest;
+}
+
+/**
+ *  Make the record the table stress test stores for a position, with
+ *  every field derived from the hash.
+ *
+ *  \param hash         The hash of the position.
+ *  \return             The record, without its key or generation.
+ */
+record_t stress_record(uint64_t hash) {
+    int k = static_cast<int>(hash >> 48);
+    record_t rec = record_t();
+    rec.best_move = static_cast<move_t>(k * 7 + 1);
+    rec.score = static_cast<value_t>(k * 11 - 500);
+    rec.eval = static_cast<value_t>(500 - k * 13);
+    rec.depth = static_cast<uint8_t>(k % 20 + 1);
+    rec.gen_bound = static_cast<uint8_t>(EXACT + k % 3);
+    return rec;
+}
+}   // namespace
+
+
+bool test_slider_attacks(std::ostream& out) {
+    sliderBackend selected = slider_backend;
+    bool passed = check_slider_backend(magicBackend, out);
+    if (cpu_has_fast_pext()) {
+        passed = check_slider_backend(pextBackend, out) && passed;
+    } else {
+        out << "  PEXT backend: not supported, skipped" << std::endl;
+    }
+    init_magics(selected);
+    return passed;
+}
+
+bool test_slider_backend_speed(std::ostream& out) {
+    sliderBackend selected = slider_backend;
+    double selected_ms = fastest_perft_time();
+    init_magics(magicBackend);
+    double magic_ms = fastest_perft_time();
+    init_magics(selected);
+
+    out << "  kiwipete perft " << SLIDER_SPEED_DEPTH << ": selected "
+        << (selected == pextBackend ? "PEXT" : "magic") << " backend "
+        << selected_ms << " ms, magic backend " << magic_ms << " ms"
+        << std::endl;
+    return selected_ms <= magic_ms * (100 + SLIDER_SPEED_TOLERANCE) / 100;
+}
+
+bool test_table_concurrency(std::ostream& out) {
+    TransTable table(1);
+    table.new_search();
+    std::atomic<uint64_t> probes(0), hits(0), torn(0);
+
+    auto hammer = [&](int thread) {
+        std::mt19937_64 rng(SELFTEST_SEED + thread);
+        uint64_t thread_probes = 0, thread_hits = 0, thread_torn = 0;
+        for (int i = 0; i < TABLE_STRESS_OPERATIONS; i++) {
+            // the low bits are zero, so every position maps to bucket 0
+            uint64_t hash = (rng() % TABLE_STRESS_POSITIONS + 1) << 48;
+            record_t want = stress_record(hash);
+            if (rng() & 1) {
+                table.save(hash, want.best_move, want.score, want.eval,
+                           want.depth, want.flag());
+                continue;
+            }
+            record_t got;
+            thread_probes++;
+            if (!table.probe(hash, &got)) continue;
+            thread_hits++;
+            if (got.best_move != want.best_move || got.score != want.score ||
+                got.eval != want.eval || got.depth != want.depth ||
+                got.flag() != want.flag()) {
+                thread_torn++;
+            }
+        }
+        probes += thread_probes;
+        hits += thread_hits;
+        torn += thread_torn;
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < TABLE_STRESS_THREADS; i++) {
+        threads.push_back(std::thread(hammer, i));
+    }
+    for (std::thread& t : threads) t.join();
+
+    out << "  " << TABLE_STRESS_THREADS << " threads, " << probes
+        << " probes, " << hits << " hits, " << torn
+        << " inconsistent records" << std::endl;
+    return torn == 0 && hits > 0;
+}
+
+bool test_table_aging(std::ostream& out) {
+    Board root("r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w "
+               "KQkq - 0 20");
+    TransTable table;
+    search_limits_t limits;
+    limits.depth = TABLE_AGING_DEPTH;
+    Board child(root);
+    Searcher first(&table);
+    child.doMoveInPlace(first.search(&root, limits));
+    move_t reply = first.expected_move(child);
+    if (!reply) {
+        out << "  no reply to the best move in the table" << std::endl;
+        return false;
+    }
+    Board grandchild(child);
+    grandchild.doMoveInPlace(reply);
+
+    uint64_t hash;
+    record_t rec;
+    grandchild.getHash(&hash);
+    bool kept = table.probe(hash, &rec) &&
+                rec.depth >= TABLE_AGING_DEPTH - 2;
+
+    // fresh searchers, so that only the table carries over
+    limits.depth = TABLE_AGING_DEPTH - 2;
+    Searcher warm(&table);
+    warm.search(&grandchild, limits);
+    uint64_t warm_nodes = warm.get_stats().nodes;
+    table.clear();
+    Searcher cold(&table);
+    cold.search(&grandchild, limits);
+    uint64_t cold_nodes = cold.get_stats().nodes;
+
+    out << "  previous search's record " << (kept ? "kept" : "lost")
+        << ", depth " << TABLE_AGING_DEPTH - 2 << " search: "
+        << warm_nodes << " nodes on the kept table, " << cold_nodes
+        << " on an empty one" << std::endl;
+    return kept && warm_nodes * 4 < cold_nodes;
+}
+
+int run_selftests(std::ostream& out) {
+    struct {
+        const char* name;
+        bool (*run)(std::ostream&);
+    } tests[] = {
+        {"slider attacks", test_slider_attacks},
+        {"slider backend speed", test_slider_backend_speed},
+        {"transposition table concurrency", test_table_concurrency},
+        {"transposition table aging", test_table_aging},
+    };
+
+    int failures = 0;
+    for (const auto& test : tests) {
+        out << test.name << ":" << std::endl;
+        bool passed = test.run(out);
+        out << (passed ? "passed" : "FAILED") << std::endl;
+        if (!passed) failures++;
+    }
+    out << std::endl << failures << " failed" << std::endl;
+    return failures;
+}
+
+}   // namespace chessCore
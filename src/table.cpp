@@ -0,0 +1,250 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "table.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <new>
+
+#include "move.h"
+#include "typedefs.h"
+
+
+namespace chessCore {
+
+std::ostream& operator<<(std::ostream &out, const record_t &rec) {
+    out << "Best/refutation move:     " << mtos(rec.best_move) << std::endl
+        << "Depth searched:           " << +rec.depth << std::endl
+        << "Generation:               " << +rec.generation() << std::endl
+        << "Bound flag:               " << (rec.flag() == UPPER ? "Upper\n" :
+                                            rec.flag() == LOWER ? "Lower\n" :
+                                                                  "Exact\n")
+
+        << "Value:                    " << rec.score << std::endl
+        << "Static evaluation:        " << rec.eval << std::endl;
+    return out;
+}
+
+namespace {
+size_t buckets_for_mb(size_t mb) {
+    size_t n = (mb << 20) / sizeof(bucket_t);
+    size_t p = 1;
+    while (2 * p <= n) p *= 2;
+    return p;
+}
+
+void empty_bucket(bucket_t* b, uint8_t epoch) {
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        b->keys[i].store(0, std::memory_order_relaxed);
+        b->data[i].store(0, std::memory_order_relaxed);
+    }
+    b->epoch.store(epoch, std::memory_order_relaxed);
+}
+
+void copy_bucket(bucket_t* dest, const bucket_t* src) {
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        dest->keys[i].store(src->keys[i].load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+        dest->data[i].store(src->data[i].load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+    }
+    dest->epoch.store(src->epoch.load(std::memory_order_relaxed),
+                      std::memory_order_relaxed);
+}
+}   // namespace
+
+
+TransTable::TransTable() : TransTable(DEFAULT_TABLE_MB) {}
+
+TransTable::TransTable(size_t mb) : memory(nullptr), buckets(nullptr) {
+    allocate(buckets_for_mb(mb));
+}
+
+TransTable::TransTable(const TransTable& other) :
+        memory(nullptr), buckets(nullptr) {
+    allocate(other.num_buckets);
+    for (size_t i = 0; i < num_buckets; i++) {
+        copy_bucket(buckets + i, other.buckets + i);
+    }
+    epoch = other.epoch;
+    generation = other.generation;
+}
+
+TransTable& TransTable::operator=(const TransTable& other) {
+    if (this == &other) return *this;
+    if (num_buckets != other.num_buckets) allocate(other.num_buckets);
+    for (size_t i = 0; i < num_buckets; i++) {
+        copy_bucket(buckets + i, other.buckets + i);
+    }
+    epoch = other.epoch;
+    generation = other.generation;
+    return *this;
+}
+
+TransTable::~TransTable() {
+    delete[] memory;
+}
+
+void TransTable::allocate(size_t n) {
+    delete[] memory;
+    num_buckets = n;
+    memory = new char[n * sizeof(bucket_t) + alignof(bucket_t)];
+    uintptr_t addr = reinterpret_cast<uintptr_t>(memory);
+    addr = (addr + alignof(bucket_t) - 1) & ~(uintptr_t(alignof(bucket_t)) - 1);
+    buckets = reinterpret_cast<bucket_t*>(addr);
+    for (size_t i = 0; i < n; i++) {
+        new (buckets + i) bucket_t;
+        empty_bucket(buckets + i, 0);
+    }
+    // new buckets have epoch 0, so start at 1 to make them all empty
+    epoch = 1;
+    generation = 0;
+}
+
+void TransTable::resize(size_t mb) {
+    allocate(buckets_for_mb(mb));
+}
+
+void TransTable::new_search() {
+    generation = (generation + 1) % NUM_GENERATIONS;
+}
+
+void TransTable::clear() {
+    epoch++;
+    if (epoch == 0) {
+        // the epoch has wrapped around, so buckets from 256 clears ago
+        // would look valid again: really empty the table this time
+        for (size_t i = 0; i < num_buckets; i++) {
+            empty_bucket(buckets + i, 0);
+        }
+        epoch = 1;
+    }
+}
+
+bool TransTable::probe(uint64_t hash, record_t* rec) const {
+    const bucket_t* b = bucket(hash);
+    if (!is_valid(*b)) return false;
+    uint16_t key = record_key(hash);
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        uint64_t data = b->data[i].load(std::memory_order_relaxed);
+        uint16_t stored = b->keys[i].load(std::memory_order_relaxed);
+        // a torn write leaves a key that doesn't match its data
+        if ((stored ^ fold_data(data)) == key) {
+            record_t found = unpack_data(key, data);
+            if (!found.gen_bound) continue;
+            *rec = found;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransTable::save(uint64_t hash, move_t best_move, value_t score,
+                      value_t eval, uint8_t depth, valueType flag) {
+    bucket_t* b = bucket(hash);
+    uint16_t key = record_key(hash);
+    int replace = -1;
+
+    if (!is_valid(*b)) {
+        // left over from before the last clear
+        empty_bucket(b, epoch);
+    }
+
+    // other threads can write to the bucket while we choose a slot, but
+    // the worst that can happen is that we replace the wrong record
+    record_t slots[BUCKET_SIZE];
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        uint64_t data = b->data[i].load(std::memory_order_relaxed);
+        uint16_t stored = b->keys[i].load(std::memory_order_relaxed);
+        slots[i] = unpack_data(stored ^ fold_data(data), data);
+    }
+
+    for (int i = 0; i < BUCKET_SIZE; i++) {
+        if (slots[i].key == key && slots[i].gen_bound) {
+            replace = i;
+            // keep the old best move if we don't have a new one
+            if (!best_move) best_move = slots[i].best_move;
+            break;
+        }
+    }
+
+    if (replace == -1) {
+        int worth, least_worth = 0;
+        for (int i = 0; i < BUCKET_SIZE - 1; i++) {
+            if (!slots[i].gen_bound) {
+                replace = i;
+                break;
+            }
+            // each search since the record was stored costs it 8 plies
+            worth = slots[i].depth - 8 * relative_age(slots[i]);
+            if (replace == -1 || worth < least_worth) {
+                replace = i;
+                least_worth = worth;
+            }
+        }
+        if (slots[replace].gen_bound && relative_age(slots[replace]) == 0 &&
+            depth < slots[replace].depth) {
+            replace = BUCKET_SIZE - 1;
+        }
+    }
+
+    record_t rec;
+    rec.key = key;
+    rec.best_move = best_move;
+    rec.score = score;
+    rec.eval = eval;
+    rec.depth = depth;
+    rec.gen_bound = (generation << 2) | flag;
+    uint64_t data = pack_data(rec);
+    b->data[replace].store(data, std::memory_order_relaxed);
+    b->keys[replace].store(key ^ fold_data(data), std::memory_order_relaxed);
+}
+
+size_t TransTable::capacity() const {
+    return num_buckets * BUCKET_SIZE;
+}
+
+size_t TransTable::size() const {
+    size_t n = 0;
+    for (size_t i = 0; i < num_buckets; i++) {
+        if (!is_valid(buckets[i])) continue;
+        for (int j = 0; j < BUCKET_SIZE; j++) {
+            uint64_t data = buckets[i].data[j].load(std::memory_order_relaxed);
+            if (unpack_data(0, data).gen_bound) n++;
+        }
+    }
+    return n;
+}
+
+int TransTable::hashfull() const {
+    size_t sample = std::min<size_t>(num_buckets, 1000 / BUCKET_SIZE);
+    size_t used = 0;
+    for (size_t i = 0; i < sample; i++) {
+        if (!is_valid(buckets[i])) continue;
+        for (int j = 0; j < BUCKET_SIZE; j++) {
+            uint64_t data = buckets[i].data[j].load(std::memory_order_relaxed);
+            record_t rec = unpack_data(0, data);
+            if (rec.gen_bound && relative_age(rec) == 0) used++;
+        }
+    }
+    return static_cast<int>(1000 * used / (sample * BUCKET_SIZE));
+}
+
+bool TransTable::at(size_t i, uint64_t* hash, record_t* rec) const {
+    const bucket_t& b = buckets[i / BUCKET_SIZE];
+    uint64_t data = b.data[i % BUCKET_SIZE].load(std::memory_order_relaxed);
+    uint16_t stored = b.keys[i % BUCKET_SIZE].load(std::memory_order_relaxed);
+    record_t slot = unpack_data(stored ^ fold_data(data), data);
+    if (!is_valid(b) || !slot.gen_bound) return false;
+    *hash = (uint64_t(slot.key) << 48) | (i / BUCKET_SIZE);
+    *rec = slot;
+    return true;
+}
+
+}   // namespace chessCore
@@ -0,0 +1,81 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "timeman.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+
+namespace chessCore {
+
+namespace {
+/**
+ *  The fraction of the soft limit to use, in percent, indexed by the number
+ *  of iterations the best move has been stable for.
+ */
+constexpr int stability_scale[] = {250, 150, 100, 75, 50};
+
+constexpr int MAX_STABILITY = sizeof(stability_scale) /
+                              sizeof(stability_scale[0]) - 1;
+}   // namespace
+
+
+TimeManager::TimeManager() : start_time(search_clock::now()),
+                             soft_limit(search_clock::duration::zero()),
+                             hard_deadline(start_time),
+                             unlimited(true) {}
+
+void TimeManager::start(const search_limits_t& limits) {
+    using std::chrono::milliseconds;
+    start_time = search_clock::now();
+    int64_t soft_ms = 0;
+    int64_t hard_ms = 0;
+
+    if (limits.move_time) {
+        // no soft limit: use all of it
+        hard_ms = limits.move_time;
+    } else if (limits.max_time) {
+        soft_ms = limits.max_time / 3;
+        hard_ms = limits.max_time;
+    } else if (limits.time_left) {
+        int64_t available = std::max<int64_t>(limits.time_left - MOVE_OVERHEAD,
+                                              1);
+        int64_t moves_to_go = limits.moves_to_go ?
+            std::min(limits.moves_to_go, DEFAULT_MOVES_TO_GO) :
+            DEFAULT_MOVES_TO_GO;
+        soft_ms = std::min(available / moves_to_go + limits.increment * 3 / 4,
+                           available);
+        // never risk more than a fraction of the clock on one move
+        hard_ms = std::min(soft_ms * 4, available / 4);
+        hard_ms = std::max(hard_ms, soft_ms);
+    }
+
+    unlimited = limits.infinite || !hard_ms;
+    soft_limit = milliseconds(soft_ms);
+    hard_deadline = start_time + milliseconds(hard_ms);
+}
+
+bool TimeManager::hard_limit_reached() const {
+    return !unlimited && search_clock::now() >= hard_deadline;
+}
+
+bool TimeManager::soft_limit_reached(int stability) const {
+    if (unlimited || soft_limit == search_clock::duration::zero()) {
+        return false;
+    }
+    int scale = stability_scale[std::min(stability, MAX_STABILITY)];
+    return search_clock::now() - start_time >= soft_limit * scale / 100;
+}
+
+double TimeManager::elapsed() const {
+    return std::chrono::duration<double>(search_clock::now() -
+                                         start_time).count();
+}
+
+}   // namespace chessCore
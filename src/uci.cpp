@@ -0,0 +1,397 @@
+/*
+Copyright (c) 2022, Frederick Pringle
+All rights reserved.
+
+This source code is licensed under the BSD-style license found in the
+LICENSE file in the root directory of this source tree.
+*/
+#include "uci.h"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "board.h"
+#include "move.h"
+#include "search.h"
+#include "table.h"
+#include "timeman.h"
+#include "typedefs.h"
+
+
+namespace chessCore {
+
+namespace {
+
+const char ENGINE_NAME[] = "strawberry";
+const char ENGINE_AUTHOR[] = "Frederick Pringle";
+
+/** The largest transposition table offered, in megabytes. */
+constexpr int MAX_HASH_MB = 4096;
+
+/** The most search threads offered. */
+constexpr int MAX_THREADS = 64;
+
+/** The largest forward pruning margin offered, in centipawns per ply. */
+constexpr int MAX_MARGIN = 1000;
+
+/** The search tunables offered as spin options, see \ref search_options_t. */
+const struct {
+    const char* name;
+    int search_options_t::* value;
+    int max;
+} spin_options[] = {
+    {"ReverseFutilityMargin", &search_options_t::reverse_futility_margin,
+     MAX_MARGIN},
+    {"RazorMargin", &search_options_t::razor_margin, MAX_MARGIN},
+    {"FutilityMargin", &search_options_t::futility_margin, MAX_MARGIN},
+    {"LateMoveCount", &search_options_t::late_move_count, MAX_MOVES},
+};
+
+std::string lower_string(std::string s) {
+    std::transform(s.begin(), s.end(), s.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return s;
+}
+
+/**
+ *  Convert a move to UCI's long algebraic notation, e.g. e2e4 or e7e8q.
+ *
+ *  \param move         The move to convert.
+ *  \return             The move string, or "0000" for no move.
+ */
+std::string uci_move(move_t move) {
+    return move ? lower_string(mtos(move)) : "0000";
+}
+
+/**
+ *  \class UCIDriver
+ *  \brief Keeps the state of a UCI session: the position, the search and
+ *  its options.
+ *
+ *  Searches run on the Searcher's worker thread. A reporter thread waits
+ *  for each one and sends its best move, so that the command loop stays
+ *  free to answer stop and isready. Only the command loop starts searches
+ *  and joins the reporter, and it always joins the reporter before
+ *  starting another search. UCI doesn't allow the best move of an infinite
+ *  search before stop, or of a ponder search before ponderhit or stop, so
+ *  the reporter holds it until then if the search ends by itself.
+ */
+class UCIDriver {
+ private:
+    /** The stream to write responses to. */
+    std::ostream& out;
+
+    /** Held while writing a line, which both threads do. */
+    std::mutex out_mutex;
+
+    /** The transposition table, kept between searches. */
+    TransTable table;
+
+    /** The searcher, which uses table. */
+    Searcher searcher;
+
+    /** The position set by the last position command. */
+    Board board;
+
+    /** The thread that sends the best move once a search ends. */
+    std::thread reporter;
+
+    /** Guards holding. */
+    std::mutex hold_mutex;
+
+    /** Signalled when holding is cleared. */
+    std::condition_variable hold_released;
+
+    /** Whether the reporter must hold the best move until it's released. */
+    bool holding = false;
+
+    /** Whether the current search is infinite, so ponderhit can't end it. */
+    bool infinite = false;
+
+    /** Let the reporter send the best move as soon as the search ends. */
+    void release_best_move() {
+        {
+            std::lock_guard<std::mutex> lock(hold_mutex);
+            holding = false;
+        }
+        hold_released.notify_all();
+    }
+
+    /**
+     *  Send a line to the GUI.
+     *
+     *  \param line         The line, without a newline.
+     */
+    void send(const std::string& line) {
+        std::lock_guard<std::mutex> lock(out_mutex);
+        out << line << std::endl;
+    }
+
+    /** Stop the search, if any, and wait for its best move to be sent. */
+    void finish_search() {
+        if (!reporter.joinable()) return;
+        searcher.stop_search();
+        release_best_move();
+        reporter.join();
+    }
+
+    /**
+     *  Send an info line for an iteration of the search.
+     *
+     *  \param info         The result of the iteration.
+     */
+    void send_info(const search_info_t& info) {
+        std::ostringstream ss;
+        int64_t us = static_cast<int64_t>(info.time * 1000000);
+        ss << "info depth " << info.depth << " score ";
+        if (std::abs(info.score) >= VAL_INFINITY) {
+            // mate scores don't record the distance, so use the PV's length
+            int moves = (static_cast<int>(info.pv.size()) + 1) / 2;
+            ss << "mate " << (info.score > 0 ? moves : -moves);
+        } else {
+            ss << "cp " << info.score;
+        }
+        ss << " nodes " << info.nodes;
+        // too short a time to measure gives no rate at all
+        if (us) ss << " nps " << info.nodes * 1000000 / us;
+        ss << " hashfull " << info.hashfull
+           << " time " << us / 1000
+           << " pv";
+        for (move_t move : info.pv) ss << " " << uci_move(move);
+        send(ss.str());
+    }
+
+    void uci() {
+        send(std::string("id name ") + ENGINE_NAME);
+        send(std::string("id author ") + ENGINE_AUTHOR);
+        send("option name Hash type spin default " +
+             std::to_string(DEFAULT_TABLE_MB) + " min 1 max " +
+             std::to_string(MAX_HASH_MB));
+        send("option name Threads type spin default 1 min 1 max " +
+             std::to_string(MAX_THREADS));
+        send("option name Ponder type check default false");
+        search_options_t defaults;
+        for (const auto& option : spin_options) {
+            send(std::string("option name ") + option.name +
+                 " type spin default " +
+                 std::to_string(defaults.*option.value) + " min 0 max " +
+                 std::to_string(option.max));
+        }
+        send("uciok");
+    }
+
+    /**
+     *  Set one of the search tunables in spin_options.
+     *
+     *  \param name         The lowercased option name.
+     *  \param value        The new value. Clamped to the option's range.
+     */
+    void set_spin_option(const std::string& name, const std::string& value) {
+        for (const auto& option : spin_options) {
+            if (name != lower_string(option.name)) continue;
+            // the search reads its options without a lock
+            finish_search();
+            search_options_t opts = searcher.get_options();
+            opts.*option.value = std::max(0, std::min(std::stoi(value),
+                                                      option.max));
+            searcher.set_options(opts);
+            return;
+        }
+        send("info string unknown option " + name);
+    }
+
+    /**
+     *  Handle "setoption name <name> value <value>".
+     *
+     *  \param args         The rest of the command.
+     */
+    void set_option(std::istringstream& args) {
+        std::string token, name, value;
+        args >> token;      // "name"
+        while (args >> token && token != "value") {
+            name += (name.empty() ? "" : " ") + token;
+        }
+        args >> value;
+        name = lower_string(name);
+        try {
+            if (name == "hash") {
+                finish_search();
+                int mb = std::max(1, std::min(std::stoi(value), MAX_HASH_MB));
+                table.resize(mb);
+            } else if (name == "threads") {
+                finish_search();
+                int n = std::max(1, std::min(std::stoi(value), MAX_THREADS));
+                searcher.set_threads(n);
+            } else if (name == "ponder") {
+                // only tells us that the GUI may send "go ponder"
+            } else {
+                set_spin_option(name, value);
+            }
+        } catch (const std::logic_error&) {
+            send("info string bad value for option " + name);
+        }
+    }
+
+    /**
+     *  Handle "position [startpos | fen <fen>] [moves <move> ...]".
+     *
+     *  \param args         The rest of the command.
+     */
+    void set_position(std::istringstream& args) {
+        finish_search();
+        std::string token, fen;
+        args >> token;
+        if (token == "startpos") {
+            board = Board();
+            args >> token;
+        } else if (token == "fen") {
+            while (args >> token && token != "moves") {
+                fen += (fen.empty() ? "" : " ") + token;
+            }
+            board = Board(fen);
+        }
+        if (token != "moves") return;
+        while (args >> token) {
+            move_t move = stom(board.gen_legal_moves(), token);
+            if (!move) {
+                send("info string illegal move " + token);
+                return;
+            }
+            board.doMoveInPlace(move);
+        }
+    }
+
+    /**
+     *  Handle "go", with any of its limits, and start the search.
+     *
+     *  \param args         The rest of the command.
+     */
+    void go(std::istringstream& args) {
+        finish_search();
+        colour side;
+        board.getSide(&side);
+        search_limits_t limits;
+        std::string token;
+        int64_t value;
+        while (args >> token) {
+            if (token == "infinite") {
+                limits.infinite = true;
+                continue;
+            }
+            if (token == "ponder") {
+                limits.ponder = true;
+                continue;
+            }
+            if (!(args >> value)) break;
+            if (token == "depth") {
+                limits.depth = static_cast<int>(value);
+            } else if (token == "nodes") {
+                limits.nodes = static_cast<uint64_t>(value);
+            } else if (token == "movetime") {
+                limits.move_time = value;
+            } else if (token == "movestogo") {
+                limits.moves_to_go = static_cast<int>(value);
+            } else if (token == (side == white ? "wtime" : "btime")) {
+                limits.time_left = value;
+            } else if (token == (side == white ? "winc" : "binc")) {
+                limits.increment = value;
+            }
+        }
+
+        infinite = limits.infinite;
+        holding = limits.infinite || limits.ponder;
+        searcher.start_search(board, limits);
+        reporter = std::thread([this]() {
+            move_t best_move = searcher.wait();
+            {
+                std::unique_lock<std::mutex> lock(hold_mutex);
+                hold_released.wait(lock, [this]() { return !holding; });
+            }
+            std::string line = "bestmove " + uci_move(best_move);
+            if (best_move) {
+                // suggest the reply to ponder on
+                Board after(board);
+                after.doMoveInPlace(best_move);
+                move_t reply = searcher.expected_move(after);
+                if (reply) line += " ponder " + uci_move(reply);
+            }
+            send(line);
+        });
+    }
+
+ public:
+    /**
+     *  Constructor for UCIDriver.
+     *
+     *  \param out          The stream to write responses to.
+     */
+    explicit UCIDriver(std::ostream& out) : out(out), searcher(&table) {
+        searcher.set_info_callback([this](const search_info_t& info) {
+            send_info(info);
+        });
+    }
+
+    /** Destructor for UCIDriver. Stops any search. */
+    ~UCIDriver() {
+        finish_search();
+    }
+
+    /**
+     *  Handle a command.
+     *
+     *  \param line         The command line.
+     *  \return             False if the command was quit, true otherwise.
+     */
+    bool command(const std::string& line) {
+        std::istringstream args(line);
+        std::string cmd;
+        if (!(args >> cmd)) return true;
+
+        if (cmd == "uci") {
+            uci();
+        } else if (cmd == "isready") {
+            send("readyok");
+        } else if (cmd == "ucinewgame") {
+            finish_search();
+            searcher.new_game();
+        } else if (cmd == "setoption") {
+            set_option(args);
+        } else if (cmd == "position") {
+            set_position(args);
+        } else if (cmd == "go") {
+            go(args);
+        } else if (cmd == "ponderhit") {
+            searcher.ponder_hit();
+            if (!infinite) release_best_move();
+        } else if (cmd == "stop") {
+            finish_search();
+        } else if (cmd == "quit") {
+            finish_search();
+            return false;
+        } else {
+            send("info string unknown command " + cmd);
+        }
+        return true;
+    }
+};
+
+}   // namespace
+
+
+void uci_loop(std::istream& in, std::ostream& out) {
+    UCIDriver driver(out);
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!driver.command(line)) break;
+    }
+}
+
+}   // namespace chessCore